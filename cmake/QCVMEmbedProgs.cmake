@@ -0,0 +1,34 @@
+#
+# qcvm_embed_progs(<target> <progs.dat> [NAME <symbol prefix>])
+#
+# Validates <progs.dat> at build time and generates a header `qcvm_embed/<prefix>.h`
+# for <target> containing the bytecode sections as `constexpr` arrays.
+# `<prefix>_createByteCode()` then creates a QC_ByteCode from that static memory.
+#
+function(qcvm_embed_progs target progsFile)
+	cmake_parse_arguments(PARSE_ARGV 2 QCVM_EMBED "" "NAME" "")
+
+	get_filename_component(progsPath ${progsFile} ABSOLUTE)
+
+	if(QCVM_EMBED_NAME)
+		set(prefix ${QCVM_EMBED_NAME})
+	else()
+		get_filename_component(prefix ${progsFile} NAME_WE)
+		string(MAKE_C_IDENTIFIER ${prefix} prefix)
+	endif()
+
+	set(outDir ${CMAKE_CURRENT_BINARY_DIR}/qcvm_embed)
+	set(outHeader ${outDir}/${prefix}.h)
+
+	add_custom_command(
+		OUTPUT ${outHeader}
+		COMMAND ${CMAKE_COMMAND} -E make_directory ${outDir}
+		COMMAND qcvm-embed ${progsPath} ${outHeader} ${prefix}
+		DEPENDS ${progsPath} qcvm-embed
+		COMMENT "Embedding QuakeC progs ${progsFile}"
+		VERBATIM
+	)
+
+	target_sources(${target} PRIVATE ${outHeader})
+	target_include_directories(${target} PRIVATE ${CMAKE_CURRENT_BINARY_DIR})
+endfunction()
@@ -24,12 +24,15 @@ typedef struct QC_DefaultBuiltins{
 #define QCVM_BUILTIN(index, name, ...) (*name)(QC_VM *vm __VA_OPT__(,) __VA_ARGS__)
 	QC_Vector	QCVM_BUILTIN(9, normalize, QC_Vector v);
 	QC_Float	QCVM_BUILTIN(12, vlen, QC_Vector v);
+	QC_Entity	QCVM_BUILTIN(18, find, QC_Entity start, QC_Uint32 field, QC_String match);
+	QC_Entity	QCVM_BUILTIN(22, findradius, QC_Vector org, QC_Float rad);
 	QC_String	QCVM_BUILTIN(26, ftos, QC_Float f);
 	QC_String	QCVM_BUILTIN(27, vtos, QC_Vector v);
 	QC_Float	QCVM_BUILTIN(36, rint, QC_Float v);
 	QC_Float	QCVM_BUILTIN(37, floor, QC_Float v);
 	QC_Float	QCVM_BUILTIN(38, ceil, QC_Float v);
 	QC_Float	QCVM_BUILTIN(43, fabs, QC_Float v);
+	QC_Entity	QCVM_BUILTIN(47, nextent, QC_Entity e);
 	QC_Float	QCVM_BUILTIN(81, stof, QC_String s);
 #undef QCVM_BUILTIN
 } QC_DefaultBuiltins;
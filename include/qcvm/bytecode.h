@@ -92,6 +92,7 @@ QCVM_PREDEF(QC_ByteCodeBuilder);
  * @brief Bytecode header
  */
 QCVM_PREDEF(QC_ByteCodeHeader);
+QCVM_PREDEF(QC_ByteCodeHeaderFTE);
 
 QCVM_PREDEF(QC_ByteCodeStatement16);
 QCVM_PREDEF(QC_ByteCodeStatement32);
@@ -137,6 +138,57 @@ static inline QC_ByteCode *qcCreateByteCode(const char *bytes, size_t len){
 	return qcCreateByteCodeA(QC_DEFAULT_ALLOC, bytes, len);
 }
 
+typedef enum QC_ByteCodeCreateFlags{
+	QC_BYTECODE_CREATE_LAZY = 0x1u, // copy statements without validating them, see `QC_VM_LOAD_LAZY`
+} QC_ByteCodeCreateFlags;
+
+/**
+ * @brief Try to create bytecode from in-memory representation
+ * @param flags Bitwise or of \ref QC_ByteCodeCreateFlags
+ * @see qcCreateByteCodeA
+ */
+QCVM_API QC_ByteCode *qcCreateByteCodeExA(const QC_Allocator *allocator, const char *bytes, size_t len, QC_Uint32 flags);
+
+//! @see qcCreateByteCodeExA
+static inline QC_ByteCode *qcCreateByteCodeEx(const char *bytes, size_t len, QC_Uint32 flags){
+	return qcCreateByteCodeExA(QC_DEFAULT_ALLOC, bytes, len, flags);
+}
+
+/**
+ * @brief Pre-validated bytecode sections in static memory
+ * @note Usually generated at build time by `qcvm_embed_progs` in CMake
+ */
+typedef struct QC_ByteCodeStatic{
+	const QC_ByteCodeStatement *stmts;
+	QC_Uintptr numStmts;
+	const QC_ByteCodeDef *defs;
+	QC_Uintptr numDefs;
+	const QC_ByteCodeField *fields;
+	QC_Uintptr numFields;
+	const QC_ByteCodeFunction *fns;
+	QC_Uintptr numFns;
+	const QC_Value *globals;
+	QC_Uintptr numGlobals;
+	const char *strs;
+	QC_Uintptr strsSize;
+	QC_Uintptr numEntityFields; // from the header, may exceed the slots covered by `fields`
+} QC_ByteCodeStatic;
+
+/**
+ * @brief Create bytecode referring directly to static memory
+ * @warning No validation is done and nothing is copied, \p data must outlive the returned bytecode
+ * @param allocator Allocator to use for the bytecode handle
+ * @param data Bytecode sections to refer to
+ * @returns Bytecode referring to \p data or `NULL` on error
+ * @see qcDestroyByteCode
+ */
+QCVM_API QC_ByteCode *qcCreateByteCodeStaticA(const QC_Allocator *allocator, const QC_ByteCodeStatic *data);
+
+//! @see qcCreateByteCodeStaticA
+static inline QC_ByteCode *qcCreateByteCodeStatic(const QC_ByteCodeStatic *data){
+	return qcCreateByteCodeStaticA(QC_DEFAULT_ALLOC, data);
+}
+
 /**
  * @brief Free previously loaded bytecode
  * @param bc Bytecode to free
@@ -157,6 +209,9 @@ QCVM_API const QC_ByteCodeDef *qcByteCodeDefs(const QC_ByteCode *bc);
 QCVM_API QC_Uintptr qcByteCodeNumFields(const QC_ByteCode *bc);
 QCVM_API const QC_ByteCodeField *qcByteCodeFields(const QC_ByteCode *bc);
 
+//! Number of 32-bit slots in each entity, at least enough for every field
+QCVM_API QC_Uintptr qcByteCodeNumEntityFields(const QC_ByteCode *bc);
+
 QCVM_API QC_Uintptr qcByteCodeNumFunctions(const QC_ByteCode *bc);
 QCVM_API const QC_ByteCodeFunction *qcByteCodeFunctions(const QC_ByteCode *bc);
 
@@ -227,6 +282,14 @@ QCVM_API QC_Uintptr qcBuilderAddFunction(QC_ByteCodeBuilder *builder, const QC_B
  */
 QCVM_API QC_Uintptr qcBuilderAddGlobal(QC_ByteCodeBuilder *builder, QC_Value value);
 
+/**
+ * @brief Reserve entity field slots beyond those covered by the added fields, like the header of a progs file
+ * @param builder Builder to set the count on
+ * @param numEntityFields Number of entity field slots
+ * @returns Whether the count was successfully set
+ */
+QCVM_API bool qcBuilderSetNumEntityFields(QC_ByteCodeBuilder *builder, QC_Uintptr numEntityFields);
+
 /**
  * @brief Add a string to a bytecode builder
  * @param builder Builder to add the string to
@@ -250,14 +313,38 @@ enum QC_Section{
 	QC_SECTION_COUNT
 };
 
+/**
+ * @brief Header versions, 16-bit tables unless an FTE header says otherwise
+ */
+enum QC_ByteCodeVersion{
+	QC_BYTECODE_VERSION		= 0x6,
+	QC_BYTECODE_VERSION_FTE	= 0x7, // followed by the rest of a \ref QC_ByteCodeHeaderFTE
+
+	// FTE secondary versions, "1FTE" xor "PROG" and "1FTE" xor "32B " read as little endian
+	QC_BYTECODE_FTE_SECONDARY_16	= 0x021B1461,
+	QC_BYTECODE_FTE_SECONDARY_32	= 0x65167402,
+};
+
 struct QC_ByteCodeHeader{
-	QC_Uint32 ver; // must be 0x6
+	QC_Uint32 ver; // must be 0x6 or 0x7
 	QC_Uint16 crc;
 	QC_Uint16 skip; // should be 0x0
 	QC_Uint32 sectionData[QC_SECTION_COUNT * 2];
 	QC_Uint32 entityFields;
 };
 
+struct QC_ByteCodeHeaderFTE{
+	QC_ByteCodeHeader base;
+	QC_Uint32 filesOff;
+	QC_Uint32 lineNumsOff;
+	QC_Uint32 bodylessFnsOff, numBodylessFns;
+	QC_Uint32 typesOff, numTypes;
+	QC_Uint32 blocksCompressed; // must be 0x0
+	QC_Uint32 secondaryVer; // selects statement, def and field widths
+};
+
+static_assert(sizeof(QC_ByteCodeHeaderFTE) == sizeof(QC_ByteCodeHeader) + 32, "misaligned QC_ByteCodeHeaderFTE");
+
 struct QC_ByteCodeStatement16{
 	QC_Uint16 op;
 	QC_Uint16 a, b, c;
@@ -26,6 +26,7 @@ typedef struct QC_VM_Fn QC_VM_Fn;
 struct QC_VM_Fn{
 	QC_VM_FnType type;
 	QC_String nameIdx;
+	QC_Uint32 flags; // QC_FunctionFlags
 };
 
 typedef QC_Value(*QC_BuiltinFn)(QC_VM *vm, void *user, void **args);
@@ -67,6 +68,9 @@ typedef struct QC_VM_Value{
 
 typedef enum QC_VM_CreateFlags{
 	QC_VM_CREATE_DEFAULT_BUILTINS = 1u,
+	QC_VM_CREATE_FAST_MATH = 1u << 2u, // approximate float division and normalize, results are not reproducible across machines
+	QC_VM_CREATE_ENTITY_SOA = 1u << 3u, // store each entity field contiguously for all entities, see \ref qcVMFieldData
+	QC_VM_CREATE_UNCHECKED_POINTERS = 1u << 4u, // trust field pointers in bytecode, stores through a forged pointer are undefined
 } QC_VM_CreateFlags;
 
 QCVM_API QC_VM *qcCreateVMA(const QC_Allocator *allocator, QC_Uint32 flags);
@@ -79,6 +83,11 @@ QCVM_API bool qcDestroyVM(QC_VM *vm);
 
 QCVM_API bool qcVMResetDefaultBuiltins(QC_VM *vm);
 
+/**
+ * @brief Set the builtin at \p index (max 65535).
+ * @note May be called while another thread executes in \p vm; running code sees the new builtin from its next call.
+ * Giving a builtin a new name, or moving a name to another index, needs a stopped VM and fails otherwise.
+ */
 QCVM_API bool qcVMSetBuiltin(QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native fn, bool overrideExisting);
 QCVM_API bool qcVMGetBuiltin(const QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native *ret);
 
@@ -86,18 +95,230 @@ QCVM_API const QC_DefaultBuiltins *qcVMDefaultBuiltins(const QC_VM *vm);
 
 QCVM_API const QC_VM_Fn *qcVMFindFn(const QC_VM *vm, const char *name, size_t nameLen);
 
+/**
+ * @brief Set the \ref QC_FunctionFlags of a named function
+ * @note Marking a function with `QC_FUNCTION_PURE` allows its results to be memoised
+ * @note Needs a stopped VM, fails if any thread (including a builtin) is executing in \p vm
+ */
+QCVM_API bool qcVMSetFnFlags(QC_VM *vm, const char *name, size_t nameLen, QC_Uint32 flags);
+
+/**
+ * @brief Set the maximum number of memoised pure function results
+ * @note A capacity of `0` (the default) disables memoisation
+ */
+QCVM_API bool qcVMSetMemoCapacity(QC_VM *vm, QC_Uintptr maxEntries);
+
+/**
+ * @brief Forget all memoised results, e.g. at the start of a frame
+ */
+QCVM_API bool qcVMClearMemo(QC_VM *vm);
+
 QCVM_API bool qcVMGetGlobal(const QC_VM *vm, const char *name, size_t nameLen, QC_VM_Value *ret);
 QCVM_API bool qcVMSetGlobal(QC_VM *vm, const char *name, size_t nameLen, QC_VM_Value value);
 
+/**
+ * Entity handles hold the entity index in the low bits, as stored in entity globals and fields, and a generation
+ * above it that changes whenever the entity is removed.
+ */
+#define QC_ENTITY_INDEX_BITS (sizeof(QC_Entity) * 4u)
+
+static inline QC_Uint32 qcEntityIndex(QC_Entity ent){
+	return (QC_Uint32)(ent & ((((QC_Entity)1) << QC_ENTITY_INDEX_BITS) - 1u));
+}
+
+/**
+ * @brief Spawn an entity with every field zeroed
+ * @note The world is entity `0`, it exists once any bytecode is loaded and can not be removed
+ */
+QCVM_API bool qcVMSpawnEntity(QC_VM *vm, QC_Entity *ret);
+
+//! Handles to \p ent held anywhere become invalid
+QCVM_API bool qcVMRemoveEntity(QC_VM *vm, QC_Entity ent);
+
+//! Get the handle of a live entity from its index, e.g. as read from an entity field
+QCVM_API bool qcVMEntityHandle(const QC_VM *vm, QC_Uint32 index, QC_Entity *ret);
+
+/**
+ * @brief Keep removed entities from being reused for \p seconds of the `time` global, `0` by default
+ * @note Quake servers use half a second, so clients never see a new entity in an old one's place
+ */
+QCVM_API bool qcVMSetEntityReuseDelay(QC_VM *vm, QC_Float seconds);
+
+//! Number of 32-bit slots in each entity, grows as modules declaring new fields are loaded
+QCVM_API QC_Uint32 qcVMNumEntityFields(const QC_VM *vm);
+
+//! Number of entities with fields, live or free, including the world
+QCVM_API QC_Uint32 qcVMNumEntities(const QC_VM *vm);
+
+/**
+ * @brief Indices of every live entity except the world, in ascending order
+ * @returns Array of `*numRet` indices, valid until the next entity is spawned or removed
+ */
+QCVM_API const QC_Uint32 *qcVMLiveEntities(const QC_VM *vm, size_t *numRet);
+
+/**
+ * @brief Get the storage of a field for bulk access
+ * @param entityStrideRet Slots between the same field of consecutive entities
+ * @param componentStrideRet Slots between the components of a vector field
+ * @returns The field of the world entity, or `NULL` on error
+ * @note Entities are contiguous in each field with `QC_VM_CREATE_ENTITY_SOA`, otherwise fields are contiguous in
+ *       each entity. Pointers stay valid for the lifetime of the VM but strides change when fields are added.
+ */
+QCVM_API void *qcVMFieldData(QC_VM *vm, const char *name, size_t nameLen, QC_Uintptr *entityStrideRet, QC_Uintptr *componentStrideRet);
+
+/**
+ * @brief Keep a hash grid over the position of every entity for the default `findradius` builtin
+ * @param cellSize Grid cell size, about the most common search radius, `0` disables the grid
+ * @note Must be called after the modules declaring `origin`, `mins` and `maxs` are loaded. Without the grid `findradius`
+ *       checks every entity, either way distances are measured to the bounding box center `origin + (mins + maxs) / 2`,
+ *       or to `origin` if there are no `mins` and `maxs` fields
+ */
+QCVM_API bool qcVMSetSpatialIndex(QC_VM *vm, QC_Float cellSize);
+
+/**
+ * @brief Index a string field for the default `find` builtin, so finding by that field skips non-matching entities
+ * @param enable `false` drops an existing index
+ */
+QCVM_API bool qcVMSetFindIndex(QC_VM *vm, const char *name, size_t nameLen, bool enable);
+
+/**
+ * @brief Index any field once `find` has scanned every entity for it \p calls times
+ * @param calls `0` only indexes fields passed to qcVMSetFindIndex, which is the default
+ */
+QCVM_API bool qcVMSetFindAutoIndex(QC_VM *vm, QC_Uint32 calls);
+
+//! Linked offset of an entity field, as passed to builtins taking a field
+QCVM_API bool qcVMFieldOffset(const QC_VM *vm, const char *name, size_t nameLen, QC_Uint32 *ret);
+
+/**
+ * @brief Record which entity fields are written, by bytecode or qcVMSetField, and in which change sequence
+ * @note Spawning marks every field of the new entity
+ */
+QCVM_API bool qcVMSetChangeTracking(QC_VM *vm, bool enabled);
+
+//! Sequence number given to changes made now, starting at `1`
+QCVM_API QC_Uint32 qcVMChangeSeq(const QC_VM *vm);
+
+//! Start a new change sequence, usually once per frame, and return its number
+QCVM_API QC_Uint32 qcVMAdvanceChangeSeq(QC_VM *vm);
+
+typedef void(*QC_VM_ChangeFn)(void *user, QC_Uint32 ent, QC_Uint32 field);
+
+/**
+ * @brief Call \p fn for every entity field written in sequence \p sinceSeq or later and not cleared yet
+ * @note Entities are given by index and fields by linked offset, each pair once with no particular order
+ */
+QCVM_API bool qcVMForEachChange(const QC_VM *vm, QC_Uint32 sinceSeq, QC_VM_ChangeFn fn, void *user);
+
+//! Forget every change last made before sequence \p beforeSeq
+QCVM_API bool qcVMClearChanges(QC_VM *vm, QC_Uint32 beforeSeq);
+
+/**
+ * @brief Call the `think` function of every entity whose `nextthink` is due by \p time
+ * Entities think once per call, earliest first then by index, with `self` set to the entity, `other` to the world
+ * and `time` to the later of its `nextthink` and the value `time` had on entry. `nextthink` is cleared before the call
+ * and `time` is set to \p time on return.
+ * @note Only entities with a pending `nextthink` are visited, writes to `nextthink` are tracked from the first call on
+ */
+QCVM_API bool qcVMRunThinks(QC_VM *vm, QC_Float time);
+
+QCVM_API bool qcVMGetField(const QC_VM *vm, QC_Entity ent, const char *name, size_t nameLen, QC_VM_Value *ret);
+QCVM_API bool qcVMSetField(QC_VM *vm, QC_Entity ent, const char *name, size_t nameLen, QC_VM_Value value);
+
+typedef QC_Uint32 QC_VM_GlobalHandle;
+typedef QC_Uint32 QC_VM_FnHandle;
+
+/**
+ * @brief Resolve a global once for use with \ref qcVMGetGlobalH and \ref qcVMSetGlobalH
+ * @note Global handles stay valid for the lifetime of the VM
+ */
+QCVM_API bool qcVMGlobalHandle(QC_VM *vm, const char *name, size_t nameLen, QC_VM_GlobalHandle *ret);
+
+QCVM_API bool qcVMGetGlobalH(const QC_VM *vm, QC_VM_GlobalHandle handle, QC_VM_Value *ret);
+QCVM_API bool qcVMSetGlobalH(QC_VM *vm, QC_VM_GlobalHandle handle, QC_VM_Value value);
+
+/**
+ * @brief Resolve a function once for use with \ref qcVMExecH
+ * @note Handles follow the name, so they call the overriding function after a load with `QC_VM_LOAD_OVERRIDE_FNS`
+ */
+QCVM_API bool qcVMFnHandle(QC_VM *vm, const char *name, size_t nameLen, QC_VM_FnHandle *ret);
+
 typedef enum QC_VM_LoadFlags{
 	QC_VM_LOAD_OVERRIDE_FNS = 0x1u,
 	QC_VM_LOAD_OVERRIDE_GLOBALS = 0x1u << 1u,
+	QC_VM_LOAD_INFER_PURE = 0x1u << 2u, // mark functions with no side-effects as QC_FUNCTION_PURE
+	QC_VM_LOAD_LAZY = 0x1u << 3u, // validate and decode each function on its first call
 } QC_VM_LoadFlags;
 
+/**
+ * @brief Link \p bc into \p vm, sharing globals, fields and functions by name with modules loaded before it
+ * @note Once bytecode has taken a field address, a module whose new fields would need wider field pointers fails to load
+ */
 QCVM_API bool qcVMLoadByteCode(QC_VM *vm, const QC_ByteCode *bc, QC_Uint32 loadFlags);
 
+/**
+ * @brief Validate and decode every function loaded with `QC_VM_LOAD_LAZY` now
+ * @returns `false` if any function failed validation
+ */
+QCVM_API bool qcVMWarmAll(QC_VM *vm);
+
+/**
+ * @brief Execute a function
+ * @note On Linux bytecode stack overflow is caught by a `SIGSEGV` handler installed the first time a VM executes
+ *       bytecode, handlers installed by the host after that must chain to the previous handler
+ */
 QCVM_API bool qcVMExec(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret);
 
+QCVM_API bool qcVMExecH(QC_VM *vm, QC_VM_FnHandle handle, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret);
+
+typedef struct QC_VM_StmtProfile{
+	QC_Uint64 hits; // times the statement ran
+	QC_Uint64 taken; // times a branch statement jumped
+} QC_VM_StmtProfile;
+
+/**
+ * @brief Count statement, branch and global accesses during every following call
+ * @note Meant for recording a profile for \ref qcVMReorderBlocks and \ref qcVMRelayoutGlobals, execution is slower
+ *       while enabled
+ */
+QCVM_API bool qcVMSetProfiling(QC_VM *vm, bool enabled);
+
+/**
+ * @brief Get the recorded profile, indexed by linked statement
+ * @note Profiles only match the same modules loaded in the same order, e.g. when saved to a file between runs
+ */
+QCVM_API const QC_VM_StmtProfile *qcVMStmtProfile(const QC_VM *vm, size_t *numStmtsRet);
+
+//! Replace the recorded profile, e.g. with one saved from a previous run
+QCVM_API bool qcVMSetStmtProfile(QC_VM *vm, const QC_VM_StmtProfile *profile, size_t numStmts);
+
+/**
+ * @brief Reorder the basic blocks of every profiled function so hot paths fall through
+ * @note Blocks that never ran are moved to the end of the code image, must not be called during execution
+ */
+QCVM_API bool qcVMReorderBlocks(QC_VM *vm);
+
+//! Get the recorded number of accesses to each linked global slot
+QCVM_API const QC_Uint64 *qcVMGlobalProfile(const QC_VM *vm, size_t *numGlobalsRet);
+QCVM_API bool qcVMSetGlobalProfile(QC_VM *vm, const QC_Uint64 *profile, size_t numGlobals);
+
+/**
+ * @brief Move the most accessed globals together right after the reserved globals
+ * @note Handles stay valid, must not be called during execution
+ */
+QCVM_API bool qcVMRelayoutGlobals(QC_VM *vm);
+
+//! Number of lanes executed in lockstep by \ref qcVMExecWide
+#define QC_VM_WIDE_LANES 8u
+
+/**
+ * @brief Run a function once per argument set, up to \ref QC_VM_WIDE_LANES sets in lockstep
+ * @param args `nLanes * nArgs` arguments, all arguments of one lane are contiguous
+ * @param rets `nLanes` return values
+ * @note Functions that call other functions or write globals other than their own locals run one lane at a time
+ */
+QCVM_API bool qcVMExecWide(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 nLanes, QC_Uint32 nArgs, QC_Value *args, QC_Value *rets);
+
 #ifdef __cplusplus
 }
 #endif
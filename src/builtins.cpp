@@ -9,12 +9,15 @@ extern "C" {
 static const QC_BuiltinInfo qcvm_defaultBuiltinsInfo[] = {
 	{ .index = 9,	.name = "normalize",	.retType = QC_BYTECODE_TYPE_VECTOR,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_VECTOR } },
 	{ .index = 12,  .name = "vlen",			.retType = QC_BYTECODE_TYPE_FLOAT,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_VECTOR } },
+	{ .index = 18,	.name = "find",			.retType = QC_BYTECODE_TYPE_ENTITY,	.nParams = 3, .paramTypes = {QC_BYTECODE_TYPE_ENTITY, QC_BYTECODE_TYPE_FIELD, QC_BYTECODE_TYPE_STRING } },
+	{ .index = 22,	.name = "findradius",	.retType = QC_BYTECODE_TYPE_ENTITY,	.nParams = 2, .paramTypes = {QC_BYTECODE_TYPE_VECTOR, QC_BYTECODE_TYPE_FLOAT } },
 	{ .index = 26,	.name = "ftos",			.retType = QC_BYTECODE_TYPE_STRING,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_FLOAT } },
 	{ .index = 27,	.name = "vtos",			.retType = QC_BYTECODE_TYPE_STRING,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_VECTOR } },
 	{ .index = 36,	.name = "rint",			.retType = QC_BYTECODE_TYPE_FLOAT,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_FLOAT } },
 	{ .index = 37,	.name = "floor",		.retType = QC_BYTECODE_TYPE_FLOAT,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_FLOAT } },
 	{ .index = 38,	.name = "ceil",			.retType = QC_BYTECODE_TYPE_FLOAT,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_FLOAT } },
 	{ .index = 43,	.name = "fabs",			.retType = QC_BYTECODE_TYPE_FLOAT,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_FLOAT } },
+	{ .index = 47,	.name = "nextent",		.retType = QC_BYTECODE_TYPE_ENTITY,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_ENTITY } },
 	{ .index = 81,	.name = "stof",			.retType = QC_BYTECODE_TYPE_FLOAT,	.nParams = 1, .paramTypes = {QC_BYTECODE_TYPE_STRING } },
 };
 
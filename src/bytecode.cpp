@@ -10,17 +10,88 @@
 
 extern "C"{
 
+QC_Uint32 qcvm_opOffsetOperands(QC_Uint32 op){
+	switch(op){
+		case QC_OP_GOTO: return 0x1;
+
+		case QC_OP_IF:
+		case QC_OP_IFNOT:
+		case QC_OP_IF_S:
+		case QC_OP_IFNOT_S:
+		case QC_OP_IF_F:
+		case QC_OP_IFNOT_F:
+		case QC_OP_SWITCH_F:
+		case QC_OP_SWITCH_V:
+		case QC_OP_SWITCH_S:
+		case QC_OP_SWITCH_E:
+		case QC_OP_SWITCH_FNC:
+		case QC_OP_SWITCH_I:
+		case QC_OP_CASE:
+			return 0x2;
+
+		case QC_OP_CASERANGE: return 0x4;
+
+		default: return 0x0;
+	}
+}
+
+// global operands are unsigned and jump offsets signed in 16-bit statements
+static inline QC_ByteCodeStatement32 qcvm_widenStatement(const QC_ByteCodeStatement16 &stmt){
+	const auto offsets = qcvm_opOffsetOperands(stmt.op);
+
+	const auto widen = [offsets](QC_Uint16 operand, QC_Uint32 bit) -> QC_Uint32{
+		return (offsets & bit) ? QC_Uint32(QC_Int32(QC_Int16(operand))) : operand;
+	};
+
+	return QC_ByteCodeStatement32{ .op = stmt.op, .a = widen(stmt.a, 0x1), .b = widen(stmt.b, 0x2), .c = widen(stmt.c, 0x4) };
+}
+
 struct QC_ByteCode{
 	const QC_Allocator *allocator;
+
+	// owned storage, left empty for static bytecode
 	std::vector<QC_ByteCodeStatement> stmts;
 	std::vector<QC_ByteCodeDef> defs;
 	std::vector<QC_ByteCodeField> fields;
 	std::vector<QC_ByteCodeFunction> fns;
 	std::vector<QC_Value> globals;
 	std::vector<char> strBuf;
+
+	std::span<const QC_ByteCodeStatement> stmtsView;
+	std::span<const QC_ByteCodeDef> defsView;
+	std::span<const QC_ByteCodeField> fieldsView;
+	std::span<const QC_ByteCodeFunction> fnsView;
+	std::span<const QC_Value> globalsView;
+	std::span<const char> strBufView;
+
+	QC_Uint32 numEntityFields = 0;
 };
 
+// slots covered by the field table, for bytecode without a header
+static inline QC_Uint32 qcvm_fieldsEnd(std::span<const QC_ByteCodeField> fields){
+	QC_Uint32 ret = 0;
+
+	for(const auto &field : fields){
+		ret = QC_MAX(ret, field.offset + (field.type == QC_BYTECODE_TYPE_VECTOR ? 3u : 1u));
+	}
+
+	return ret;
+}
+
+static inline void qcvm_byteCodeViewStorage(QC_ByteCode *bc){
+	bc->stmtsView = bc->stmts;
+	bc->defsView = bc->defs;
+	bc->fieldsView = bc->fields;
+	bc->fnsView = bc->fns;
+	bc->globalsView = bc->globals;
+	bc->strBufView = bc->strBuf;
+}
+
 QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes, size_t len){
+	return qcCreateByteCodeExA(allocator, bytes, len, 0);
+}
+
+QC_ByteCode *qcCreateByteCodeExA(const QC_Allocator *allocator, const char *bytes, size_t len, QC_Uint32 flags){
 	if(len < sizeof(QC_ByteCodeHeader)){
 		qcLogError("invalid bytecode: size smaller than sizeof(QC_ByteCodeHeader)");
 		return nullptr;
@@ -37,8 +108,8 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 		return header.sectionData[(std::size_t(section) * 2) + 1];
 	};
 
-	if(header.ver != 0x6){
-		qcLogError("invalid bytecode: wrong header version, should be 0x6");
+	if(header.ver != QC_BYTECODE_VERSION && header.ver != QC_BYTECODE_VERSION_FTE){
+		qcLogError("invalid bytecode: wrong header version 0x%x, should be 0x6 or 0x7", header.ver);
 		return nullptr;
 	}
 
@@ -46,11 +117,40 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 		qcLogWarn("bad bytecode: wrong header skip value 0x%ux, should be 0x0", header.skip);
 	}
 
-	static constexpr auto sectionDataSize = [](QC_Section section) -> std::size_t{
+	// classic progs store 16-bit statements, defs and fields, FTE headers say when they are 32-bit
+	bool wide = false;
+
+	if(header.ver == QC_BYTECODE_VERSION_FTE){
+		if(len < sizeof(QC_ByteCodeHeaderFTE)){
+			qcLogError("invalid bytecode: size smaller than sizeof(QC_ByteCodeHeaderFTE)");
+			return nullptr;
+		}
+
+		QC_ByteCodeHeaderFTE headerFTE;
+		std::memcpy(&headerFTE, bytes, sizeof(headerFTE));
+
+		if(headerFTE.blocksCompressed != 0x0){
+			qcLogError("invalid bytecode: compressed sections are not supported");
+			return nullptr;
+		}
+		else if(headerFTE.secondaryVer == QC_BYTECODE_FTE_SECONDARY_32){
+			wide = true;
+		}
+		else if(headerFTE.secondaryVer != QC_BYTECODE_FTE_SECONDARY_16){
+			qcLogError("invalid bytecode: unknown secondary version 0x%x", headerFTE.secondaryVer);
+			return nullptr;
+		}
+	}
+
+	const auto stmtSize = wide ? sizeof(QC_ByteCodeStatement32) : sizeof(QC_ByteCodeStatement16);
+	const auto defSize = wide ? sizeof(QC_ByteCodeDef32) : sizeof(QC_ByteCodeDef16);
+	const auto fieldSize = wide ? sizeof(QC_ByteCodeField32) : sizeof(QC_ByteCodeField16);
+
+	const auto sectionDataSize = [=](QC_Section section) -> std::size_t{
 		switch(section){
-			case QC_SECTION_STATEMENTS: return sizeof(QC_ByteCodeStatement32);
-			case QC_SECTION_DEFS: return sizeof(QC_ByteCodeDef16);
-			case QC_SECTION_FIELDS: return sizeof(QC_ByteCodeField16);
+			case QC_SECTION_STATEMENTS: return stmtSize;
+			case QC_SECTION_DEFS: return defSize;
+			case QC_SECTION_FIELDS: return fieldSize;
 			case QC_SECTION_FUNCTIONS: return sizeof(QC_ByteCodeFunction);
 			case QC_SECTION_GLOBALS: return 4;
 			default: return 1;
@@ -63,6 +163,14 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 		return std::span<const char>(bytes + off, len);
 	};
 
+	for(std::size_t i = 0; i < QC_SECTION_COUNT; i++){
+		const auto section = QC_Section(i);
+		if(std::size_t(sectionOff(section)) + (std::size_t(sectionLen(section)) * sectionDataSize(section)) > len){
+			qcLogError("invalid bytecode: section %zu extends past the end of the data", i);
+			return nullptr;
+		}
+	}
+
 	const auto stmtsData = sectionData(QC_SECTION_STATEMENTS);
 	const auto defsData  = sectionData(QC_SECTION_DEFS);
 	const auto fldsData  = sectionData(QC_SECTION_FIELDS);
@@ -98,39 +206,78 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 	strBuf.resize(strsData.size());
 	std::memcpy(strBuf.data(), strsData.data(), strsData.size()); // strBuf done
 
-	for(QC_Uint32 i = 0; i < numStmts; i++){
+	const auto readStmt = [&](QC_Uint32 i){
+		if(stmtSize == sizeof(QC_ByteCodeStatement16)){
+			QC_ByteCodeStatement16 stmt;
+			std::memcpy(&stmt, stmtsData.data() + (i * sizeof(stmt)), sizeof(stmt));
+			return qcvm_widenStatement(stmt);
+		}
+
 		QC_ByteCodeStatement32 stmt;
 		std::memcpy(&stmt, stmtsData.data() + (i * sizeof(stmt)), sizeof(stmt));
+		return stmt;
+	};
 
-		if(stmt.op >= QC_OP_COUNT){
-			qcLogError("invalid bytecode: unknown instruction 0x%ux", stmt.op);
-			return nullptr;
+	if(flags & QC_BYTECODE_CREATE_LAZY){
+		// the VM validates each function body when it is first called
+		if(stmtSize == sizeof(QC_ByteCodeStatement32)){
+			stmts.resize(numStmts);
+			std::memcpy(stmts.data(), stmtsData.data(), stmtsData.size());
 		}
+		else{
+			for(QC_Uint32 i = 0; i < numStmts; i++){
+				stmts.push_back(readStmt(i));
+			}
+		}
+	}
+	else{
+		for(QC_Uint32 i = 0; i < numStmts; i++){
+			const auto stmt = readStmt(i);
+
+			if(stmt.op >= QC_OP_COUNT){
+				qcLogError("invalid bytecode: unknown instruction 0x%ux", stmt.op);
+				return nullptr;
+			}
 
-		stmts.push_back(stmt);
+			stmts.push_back(stmt);
+		}
 	}
 
 	for(QC_Uint32 i = 0; i < numDefs; i++){
-		QC_ByteCodeDef16 def;
-		std::memcpy(&def, defsData.data() + (i * sizeof(def)), sizeof(def));
+		QC_ByteCodeDef def;
+
+		if(defSize == sizeof(QC_ByteCodeDef32)){
+			std::memcpy(&def, defsData.data() + (i * defSize), defSize);
+		}
+		else{
+			QC_ByteCodeDef16 def16;
+			std::memcpy(&def16, defsData.data() + (i * defSize), defSize);
+			def = QC_ByteCodeDef{ .type = def16.type, .globalIdx = def16.globalIdx, .nameIdx = def16.nameIdx };
+		}
 
 		if(def.nameIdx >= strsData.size()){
 			qcLogError("invalid name index %u", def.nameIdx);
 			return nullptr;
 		}
-		else if(def.globalIdx >= glbsData.size()){
+		else if(def.globalIdx >= numGlbs){
 			qcLogError("Invalid global index %u in def '%s'", def.globalIdx, strsData.data() + def.nameIdx);
 			return nullptr;
 		}
 
-		defs.push_back(
-			QC_ByteCodeDef{ .type = def.type, .globalIdx = def.globalIdx, .nameIdx = def.nameIdx }
-		);
+		defs.push_back(def);
 	}
 
 	for(QC_Uint32 i = 0; i < numFields; i++){
-		QC_ByteCodeField16 field;
-		std::memcpy(&field, fldsData.data() + (i * sizeof(field)), sizeof(field));
+		QC_ByteCodeField field;
+
+		if(fieldSize == sizeof(QC_ByteCodeField32)){
+			std::memcpy(&field, fldsData.data() + (i * fieldSize), fieldSize);
+		}
+		else{
+			QC_ByteCodeField16 field16;
+			std::memcpy(&field16, fldsData.data() + (i * fieldSize), fieldSize);
+			field = QC_ByteCodeField{ .type = field16.type, .offset = field16.offset, .nameIdx = field16.nameIdx };
+		}
 
 		if(field.nameIdx >= strsData.size()){
 			qcLogError("invalid field name index %u", field.nameIdx);
@@ -140,12 +287,12 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 			qcLogError("unrecognized type id 0x%ux for field '%s'", field.type, strsData.data() + field.nameIdx);
 			return nullptr;
 		}
-		else if(field.offset >= glbsData.size()){
+		else if(field.offset >= header.entityFields){
 			qcLogError("invalid offset %u for field '%s'", field.offset, strsData.data() + field.nameIdx);
 			return nullptr;
 		}
 
-		fields.push_back(QC_ByteCodeField{ .type = field.type, .offset = field.offset, .nameIdx = field.nameIdx });
+		fields.push_back(field);
 	}
 
 	for(QC_Uint32 i = 0; i < numFns; i++){
@@ -156,7 +303,7 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 			qcLogError("invalid function name index %u", fn.nameIdx);
 			return nullptr;
 		}
-		else if(fn.entryPoint > 0 && fn.entryPoint >= stmtsData.size()){
+		else if(fn.entryPoint > 0 && QC_Uint32(fn.entryPoint) >= numStmts){
 			qcLogError("invalid entry point %d for function '%s'", fn.entryPoint, strsData.data() + fn.nameIdx);
 			return nullptr;
 		}
@@ -182,6 +329,37 @@ QC_ByteCode *qcCreateByteCodeA(const QC_Allocator *allocator, const char *bytes,
 	p->globals = std::move(globals);
 	p->strBuf = std::move(strBuf);
 
+	qcvm_byteCodeViewStorage(p);
+
+	// the last field may be a vector starting in the last slot
+	p->numEntityFields = QC_MAX(header.entityFields, qcvm_fieldsEnd(p->fieldsView));
+
+	return p;
+}
+
+QC_ByteCode *qcCreateByteCodeStaticA(const QC_Allocator *allocator, const QC_ByteCodeStatic *data){
+	if(!data){
+		qcLogError("NULL data argument passed");
+		return nullptr;
+	}
+
+	auto bcMem = qcAllocA(allocator, sizeof(QC_ByteCode), alignof(QC_ByteCode));
+	if(!bcMem){
+		qcLogError("failed to allocate memory for QC_Bytecode");
+		return nullptr;
+	}
+
+	auto p = new(bcMem) QC_ByteCode;
+
+	p->allocator = allocator;
+	p->stmtsView = { data->stmts, data->numStmts };
+	p->defsView = { data->defs, data->numDefs };
+	p->fieldsView = { data->fields, data->numFields };
+	p->fnsView = { data->fns, data->numFns };
+	p->globalsView = { data->globals, data->numGlobals };
+	p->strBufView = { data->strs, data->strsSize };
+	p->numEntityFields = QC_MAX(QC_Uint32(data->numEntityFields), qcvm_fieldsEnd(p->fieldsView));
+
 	return p;
 }
 
@@ -200,23 +378,24 @@ bool qcDestroyByteCode(QC_ByteCode *bc){
 	return true;
 }
 
-QC_Uintptr qcByteCodeStringsSize(const QC_ByteCode *bc){ return bc->strBuf.size(); }
-const char *qcByteCodeStrings(const QC_ByteCode *bc){ return bc->strBuf.data(); }
+QC_Uintptr qcByteCodeStringsSize(const QC_ByteCode *bc){ return bc->strBufView.size(); }
+const char *qcByteCodeStrings(const QC_ByteCode *bc){ return bc->strBufView.data(); }
 
-QC_Uintptr qcByteCodeNumStatements(const QC_ByteCode *bc){ return bc->stmts.size(); }
-const QC_ByteCodeStatement *qcByteCodeStatements(const QC_ByteCode *bc){ return bc->stmts.data(); }
+QC_Uintptr qcByteCodeNumStatements(const QC_ByteCode *bc){ return bc->stmtsView.size(); }
+const QC_ByteCodeStatement *qcByteCodeStatements(const QC_ByteCode *bc){ return bc->stmtsView.data(); }
 
-QC_Uintptr qcByteCodeNumDefs(const QC_ByteCode *bc){ return bc->defs.size(); }
-const QC_ByteCodeDef *qcByteCodeDefs(const QC_ByteCode *bc){ return bc->defs.data(); }
+QC_Uintptr qcByteCodeNumDefs(const QC_ByteCode *bc){ return bc->defsView.size(); }
+const QC_ByteCodeDef *qcByteCodeDefs(const QC_ByteCode *bc){ return bc->defsView.data(); }
 
-QC_Uintptr qcByteCodeNumFields(const QC_ByteCode *bc){ return bc->fields.size(); }
-const QC_ByteCodeField *qcByteCodeFields(const QC_ByteCode *bc){ return bc->fields.data(); }
+QC_Uintptr qcByteCodeNumFields(const QC_ByteCode *bc){ return bc->fieldsView.size(); }
+const QC_ByteCodeField *qcByteCodeFields(const QC_ByteCode *bc){ return bc->fieldsView.data(); }
+QC_Uintptr qcByteCodeNumEntityFields(const QC_ByteCode *bc){ return bc->numEntityFields; }
 
-QC_Uintptr qcByteCodeNumFunctions(const QC_ByteCode *bc){ return bc->fns.size(); }
-const QC_ByteCodeFunction *qcByteCodeFunctions(const QC_ByteCode *bc){ return bc->fns.data(); }
+QC_Uintptr qcByteCodeNumFunctions(const QC_ByteCode *bc){ return bc->fnsView.size(); }
+const QC_ByteCodeFunction *qcByteCodeFunctions(const QC_ByteCode *bc){ return bc->fnsView.data(); }
 
-QC_Uintptr qcByteCodeNumGlobals(const QC_ByteCode *bc){ return bc->globals.size(); }
-const QC_Value *qcByteCodeGlobals(const QC_ByteCode *bc){ return bc->globals.data(); }
+QC_Uintptr qcByteCodeNumGlobals(const QC_ByteCode *bc){ return bc->globalsView.size(); }
+const QC_Value *qcByteCodeGlobals(const QC_ByteCode *bc){ return bc->globalsView.data(); }
 
 struct QC_ByteCodeBuilder{
 	std::mutex mut;
@@ -253,6 +432,10 @@ QC_ByteCode *qcBuilderEmit(QC_ByteCodeBuilder *builder){
 
 	*p = builder->bc;
 
+	p->allocator = QC_DEFAULT_ALLOC;
+	qcvm_byteCodeViewStorage(p);
+	p->numEntityFields = QC_MAX(builder->bc.numEntityFields, qcvm_fieldsEnd(p->fieldsView));
+
 	return p;
 }
 
@@ -334,9 +517,9 @@ QC_Uintptr qcBuilderAddFunction(QC_ByteCodeBuilder *builder, const QC_ByteCodeFu
 		qcLogError("invalid name string index %u", fn->nameIdx);
 		return UINT32_MAX;
 	}
-	else if(fn->entryPoint >= builder->bc.stmts.size()){
+	else if(fn->entryPoint > 0 && QC_Uint32(fn->entryPoint) >= builder->bc.stmts.size()){
 		qcLogError(
-			"invalid entry point 0x%ux for function '%s'",
+			"invalid entry point %d for function '%s'",
 			fn->entryPoint, builder->bc.strBuf.data() + fn->nameIdx
 		);
 		return UINT32_MAX;
@@ -381,6 +564,21 @@ QC_Uintptr qcBuilderAddGlobal(QC_ByteCodeBuilder *builder, QC_Value value){
 	return idx;
 }
 
+bool qcBuilderSetNumEntityFields(QC_ByteCodeBuilder *builder, QC_Uintptr numEntityFields){
+	if(!builder){
+		qcLogError("NULL builder argument passed");
+		return false;
+	}
+	else if(numEntityFields > UINT32_MAX){
+		qcLogError("too many entity fields %zu", size_t(numEntityFields));
+		return false;
+	}
+
+	std::scoped_lock lock(builder->mut);
+	builder->bc.numEntityFields = QC_Uint32(numEntityFields);
+	return true;
+}
+
 QC_Uintptr qcBuilderAddString(QC_ByteCodeBuilder *builder, const char *str, size_t len){
 	if(!builder){
 		qcLogError("NULL argument passed");
@@ -0,0 +1,1036 @@
+#define QCVM_IMPLEMENTATION
+
+#include "qcvm/vm_impl.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <functional>
+
+QC_VM_EntityStore::~QC_VM_EntityStore(){
+	if(mem) qcvm_unmapStack(mem, memSize);
+}
+
+bool QC_VM_EntityStore::reserve(){
+	if(mem) return true;
+
+	// same lazily committed mapping as the interpreter stacks, overruns fault in the guard after it
+	mem = qcvm_mapStack(QCVM_ENTITY_ARENA_BYTES);
+	if(!mem) return false;
+
+	memSize = QCVM_ENTITY_ARENA_BYTES;
+	base = static_cast<QC_VM_Slot*>(mem);
+
+	entStep = soa ? 1u : stride;
+	fieldStep = soa ? QCVM_ENTITY_COLUMN_SIZE : 1u;
+
+	for(QC_Uint32 i = 0; i < stride; i++){
+		slot(0, i).u32 = 0;
+	}
+
+	// allocating here keeps spawn and remove storms in a small world allocation free
+	info.reserve(QC_MIN(capacity(), QCVM_ENTITY_COLUMN_SIZE));
+	info.assign(1, QC_VM_EntityInfo{ .gen = 0, .nextFree = QCVM_NO_ENTITY, .freeTime = 0.f, .live = true });
+
+	numEnts = 1;
+	return true;
+}
+
+bool QC_VM_EntityStore::setStride(QC_Uint32 newStride){
+	if(newStride <= stride){
+		return true;
+	}
+	else if(soa && (QC_Uint64(newStride) * QCVM_ENTITY_COLUMN_SIZE * sizeof(QC_VM_Slot)) > QCVM_ENTITY_ARENA_BYTES){
+		qcLogError("%u entity fields do not fit in the entity arena", newStride);
+		return false;
+	}
+	else if(!soa && (QC_Uint64(numEnts) * newStride * sizeof(QC_VM_Slot)) > memSize && mem){
+		qcLogError("%u entities with %u fields do not fit in the entity arena", numEnts, newStride);
+		return false;
+	}
+
+	// field pointers keep just enough bits for every field, the arena runs out of entities long before the rest does
+	const auto newShift = 31u - QC_Uint32(std::bit_width(newStride + 2u));
+	if(newShift != ptrShift && ptrsTaken){
+		qcLogError("can not grow entities to %u fields after field pointers were taken", newStride);
+		return false;
+	}
+
+	ptrShift = newShift;
+	fieldWatch.resize(QC_Uintptr(1) << (31u - ptrShift), changes.enabled ? QCVM_WATCH_CHANGES : 0);
+
+	if(!mem){
+		stride = newStride;
+		return true;
+	}
+	else if(soa){
+		// new columns only need clearing for existing entities
+		for(QC_Uint32 i = stride; i < newStride; i++){
+			std::memset(base + (QC_Uintptr(i) * QCVM_ENTITY_COLUMN_SIZE), 0, numEnts * sizeof(QC_VM_Slot));
+		}
+
+		stride = newStride;
+		return true;
+	}
+
+	// blocks only move up, so going from the last one down never overwrites one that hasn't moved yet
+	for(QC_Uint32 i = numEnts; i-- > 0;){
+		const auto dst = base + (QC_Uintptr(i) * newStride);
+		std::memmove(dst, base + (QC_Uintptr(i) * stride), stride * sizeof(QC_VM_Slot));
+		std::memset(dst + stride, 0, (newStride - stride) * sizeof(QC_VM_Slot));
+	}
+
+	stride = entStep = newStride;
+	return true;
+}
+
+QC_Uint32 QC_VM_EntityStore::spawn(QC_Float now){
+	if(!reserve()){
+		return 0;
+	}
+
+	QC_Uint32 ent;
+
+	// time going backwards means a new level, so nothing still refers to old entities
+	const bool canReuse = freeHead != QCVM_NO_ENTITY
+		&& (now < info[freeHead].freeTime || (now - info[freeHead].freeTime) >= reuseDelay);
+
+	if(canReuse || (freeHead != QCVM_NO_ENTITY && numEnts >= capacity())){
+		ent = freeHead;
+		freeHead = info[ent].nextFree;
+		if(freeHead == QCVM_NO_ENTITY) freeTail = QCVM_NO_ENTITY;
+	}
+	else if(numEnts < capacity()){
+		ent = numEnts++;
+		info.emplace_back(QC_VM_EntityInfo{ .gen = 0, .nextFree = QCVM_NO_ENTITY, .freeTime = 0.f, .live = false });
+	}
+	else{
+		qcLogError("entity arena is full (%u entities)", numEnts);
+		return 0;
+	}
+
+	for(QC_Uint32 i = 0; i < stride; i++){
+		slot(ent, i).u32 = 0;
+	}
+
+	info[ent].live = true;
+	info[ent].nextFree = QCVM_NO_ENTITY;
+
+	if(ent / 64u >= liveBits.size()){
+		liveBits.resize((ent / 64u) + 1, 0);
+	}
+
+	liveBits[ent / 64u] |= QC_Uint64(1) << (ent % 64u);
+	liveListStale = true;
+
+	touchAll(ent);
+
+	// zeroing counts as a change, a reused entity may have had anything in its fields
+	if(changes.enabled){
+		changes.markAll(ent, stride);
+	}
+
+	return ent;
+}
+
+void QC_VM_EntityStore::remove(QC_Uint32 ent, QC_Float now){
+	// fields are left as they were until the entity is reused, like freed edicts
+	auto &entInfo = info[ent];
+	entInfo.live = false;
+	entInfo.freeTime = now;
+	++entInfo.gen;
+
+	liveBits[ent / 64u] &= ~(QC_Uint64(1) << (ent % 64u));
+	liveListStale = true;
+
+	if(freeTail == QCVM_NO_ENTITY){
+		freeHead = ent;
+	}
+	else{
+		info[freeTail].nextFree = ent;
+	}
+
+	freeTail = ent;
+
+	touchAll(ent);
+}
+
+void QC_VM_EntityStore::touch(QC_Uint32 ent, QC_Uint32 field){
+	const auto watch = fieldWatch[field];
+
+	if(watch & QCVM_WATCH_SPATIAL){
+		spatial.markDirty(ent);
+	}
+
+	if(watch & QCVM_WATCH_FIND){
+		findIndex(field)->markDirty(ent);
+	}
+
+	if(watch & QCVM_WATCH_CHANGES){
+		changes.mark(ent, field);
+	}
+
+	if(watch & QCVM_WATCH_THINK){
+		thinks.markDirty(ent);
+	}
+}
+
+void QC_VM_EntityStore::touchAll(QC_Uint32 ent){
+	if(spatial.field != QCVM_NO_ENTITY){
+		spatial.markDirty(ent);
+	}
+
+	for(auto &index : findIndices){
+		index.markDirty(ent);
+	}
+
+	if(thinks.field != QCVM_NO_ENTITY){
+		thinks.markDirty(ent);
+	}
+}
+
+// where findradius measures from, like the original engine
+static inline QC_Vector qcvm_radiusPoint(const QC_VM_EntityStore &ents, QC_Uint32 ent, QC_Uint32 origin, QC_Uint32 mins, QC_Uint32 maxs){
+	QC_Vector ret = { ents.slot(ent, origin).f32, ents.slot(ent, origin + 1).f32, ents.slot(ent, origin + 2).f32 };
+
+	if(mins != QCVM_NO_ENTITY && maxs != QCVM_NO_ENTITY){
+		ret.x += (ents.slot(ent, mins).f32 + ents.slot(ent, maxs).f32) * 0.5f;
+		ret.y += (ents.slot(ent, mins + 1).f32 + ents.slot(ent, maxs + 1).f32) * 0.5f;
+		ret.z += (ents.slot(ent, mins + 2).f32 + ents.slot(ent, maxs + 2).f32) * 0.5f;
+	}
+
+	return ret;
+}
+
+static inline bool qcvm_inRadius(QC_Vector p, QC_Vector org, QC_Float radSq){
+	const auto dx = p.x - org.x;
+	const auto dy = p.y - org.y;
+	const auto dz = p.z - org.z;
+	return ((dx * dx) + (dy * dy) + (dz * dz)) <= radSq;
+}
+
+// 21 bits per axis, enough for any map at a sensible cell size
+static inline QC_Uint64 qcvm_cellKey(QC_Int64 x, QC_Int64 y, QC_Int64 z){
+	constexpr QC_Uint64 mask = (1u << 21u) - 1u;
+	return (QC_Uint64(x) & mask) | ((QC_Uint64(y) & mask) << 21u) | ((QC_Uint64(z) & mask) << 42u);
+}
+
+static inline QC_Int64 qcvm_cellCoord(QC_Float v, QC_Float cellSize){
+	return QC_Int64(std::floor(v / cellSize));
+}
+
+void QC_VM_SpatialIndex::markDirty(QC_Uint32 ent){
+	if(ent >= entries.size()){
+		entries.resize(ent + 1, Entry{ .cell = 0, .pos = 0, .indexed = false, .dirty = false });
+	}
+
+	if(!entries[ent].dirty){
+		entries[ent].dirty = true;
+		dirty.emplace_back(ent);
+	}
+}
+
+void QC_VM_SpatialIndex::flush(const QC_VM_EntityStore &ents){
+	for(const auto ent : dirty){
+		auto &entry = entries[ent];
+		entry.dirty = false;
+
+		QC_Uint64 cell = 0;
+		const bool live = ents.isLive(ent) && ent != 0;
+
+		if(live){
+			const auto p = qcvm_radiusPoint(ents, ent, field, mins, maxs);
+			cell = qcvm_cellKey(qcvm_cellCoord(p.x, cellSize), qcvm_cellCoord(p.y, cellSize), qcvm_cellCoord(p.z, cellSize));
+
+			if(entry.indexed && entry.cell == cell){
+				continue;
+			}
+		}
+
+		if(entry.indexed){
+			auto &members = cells[entry.cell];
+			const auto moved = members.back();
+			members[entry.pos] = moved;
+			entries[moved].pos = entry.pos;
+			members.pop_back();
+			entry.indexed = false;
+		}
+
+		if(live){
+			auto &members = cells[cell];
+			entry.cell = cell;
+			entry.pos = QC_Uint32(members.size());
+			entry.indexed = true;
+			members.emplace_back(ent);
+		}
+	}
+
+	dirty.clear();
+}
+
+void QC_VM_SpatialIndex::query(const QC_VM_EntityStore &ents, QC_Vector org, QC_Float rad, std::vector<QC_Uint32> &ret){
+	flush(ents);
+
+	const auto radSq = rad * rad;
+
+	const auto test = [&](QC_Uint32 ent){
+		if(qcvm_inRadius(qcvm_radiusPoint(ents, ent, field, mins, maxs), org, radSq)){
+			ret.emplace_back(ent);
+		}
+	};
+
+	const QC_Int64 lo[] = { qcvm_cellCoord(org.x - rad, cellSize), qcvm_cellCoord(org.y - rad, cellSize), qcvm_cellCoord(org.z - rad, cellSize) };
+	const QC_Int64 hi[] = { qcvm_cellCoord(org.x + rad, cellSize), qcvm_cellCoord(org.y + rad, cellSize), qcvm_cellCoord(org.z + rad, cellSize) };
+
+	const auto numCells = QC_Uint64(hi[0] - lo[0] + 1) * QC_Uint64(hi[1] - lo[1] + 1) * QC_Uint64(hi[2] - lo[2] + 1);
+
+	// huge radii cover more cells than there are entities
+	if(numCells > cells.size()){
+		for(const auto &cell : cells){
+			for(const auto ent : cell.second) test(ent);
+		}
+
+		return;
+	}
+
+	for(auto z = lo[2]; z <= hi[2]; z++){
+		for(auto y = lo[1]; y <= hi[1]; y++){
+			for(auto x = lo[0]; x <= hi[0]; x++){
+				const auto res = cells.find(qcvm_cellKey(x, y, z));
+				if(res == cells.end()) continue;
+
+				for(const auto ent : res->second) test(ent);
+			}
+		}
+	}
+}
+
+void QC_VM_FindIndex::markDirty(QC_Uint32 ent){
+	if(ent >= entries.size()){
+		entries.resize(ent + 1, Entry{ .key = 0, .indexed = false, .dirty = false });
+	}
+
+	if(!entries[ent].dirty){
+		entries[ent].dirty = true;
+		dirty.emplace_back(ent);
+	}
+}
+
+QC_Uint32 QC_VM_FindIndex::intern(std::string_view str){
+	const auto res = keys.find(str);
+	if(res != keys.end()){
+		return res->second;
+	}
+
+	const auto key = QC_Uint32(members.size());
+	keys.emplace(std::string(str), key);
+	members.emplace_back();
+	return key;
+}
+
+void QC_VM_FindIndex::flush(const QC_VM_EntityStore &ents, const QC_StringBuffer *strBuf){
+	for(const auto ent : dirty){
+		auto &entry = entries[ent];
+		entry.dirty = false;
+
+		QC_Uint32 key = 0;
+		const bool live = ents.isLive(ent);
+
+		if(live){
+			const auto s = ents.slot(ent, field).u32;
+			const auto str = s ? qcString(strBuf, s) : QC_EMPTY_STRVIEW;
+			key = intern(str.ptr ? std::string_view(str.ptr, str.len) : std::string_view());
+
+			if(entry.indexed && entry.key == key){
+				continue;
+			}
+		}
+
+		// sorted inserts and erases move the tail of one member list, cheap next to scanning every entity
+		if(entry.indexed){
+			auto &list = members[entry.key];
+			list.erase(std::lower_bound(list.begin(), list.end(), ent));
+			entry.indexed = false;
+		}
+
+		if(live){
+			auto &list = members[key];
+			list.insert(std::lower_bound(list.begin(), list.end(), ent), ent);
+			entry.key = key;
+			entry.indexed = true;
+		}
+	}
+
+	dirty.clear();
+}
+
+QC_Uint32 QC_VM_FindIndex::next(QC_Uint32 start, std::string_view match) const{
+	const auto res = keys.find(match);
+	if(res == keys.end()){
+		return 0;
+	}
+
+	const auto &list = members[res->second];
+	const auto it = std::upper_bound(list.begin(), list.end(), start);
+	return it == list.end() ? 0 : *it;
+}
+
+void QC_VM_ChangeLog::mark(QC_Uint32 ent, QC_Uint32 field){
+	if(ent >= entries.size()){
+		entries.resize(ent + 1, Entry{ .seq = 0, .listed = false, .bits = {}, .fieldSeq = {} });
+	}
+
+	auto &entry = entries[ent];
+
+	if(field >= entry.fieldSeq.size()){
+		entry.fieldSeq.resize(field + 1, 0);
+		entry.bits.resize((field / 64u) + 1, 0);
+	}
+
+	entry.seq = seq;
+	entry.fieldSeq[field] = seq;
+	entry.bits[field / 64u] |= QC_Uint64(1) << (field % 64u);
+
+	if(!entry.listed){
+		entry.listed = true;
+		changed.emplace_back(ent);
+	}
+}
+
+void QC_VM_ChangeLog::markAll(QC_Uint32 ent, QC_Uint32 numFields){
+	for(QC_Uint32 i = 0; i < numFields; i++){
+		mark(ent, i);
+	}
+}
+
+void QC_VM_ChangeLog::clear(QC_Uint32 beforeSeq){
+	auto out = changed.begin();
+
+	for(const auto ent : changed){
+		auto &entry = entries[ent];
+		bool any = false;
+
+		if(entry.seq >= beforeSeq){
+			for(QC_Uint32 w = 0; w < entry.bits.size(); w++){
+				for(auto word = entry.bits[w]; word; word &= word - 1){
+					const auto field = (w * 64u) + QC_Uint32(std::countr_zero(word));
+
+					if(entry.fieldSeq[field] < beforeSeq){
+						entry.bits[w] &= ~(QC_Uint64(1) << (field % 64u));
+					}
+				}
+
+				any |= entry.bits[w] != 0;
+			}
+		}
+		else{
+			std::fill(entry.bits.begin(), entry.bits.end(), 0);
+		}
+
+		entry.listed = any;
+		if(any) *out++ = ent;
+	}
+
+	changed.erase(out, changed.end());
+}
+
+void QC_VM_ThinkQueue::markDirty(QC_Uint32 ent){
+	if(ent >= entries.size()){
+		entries.resize(ent + 1, Entry{ .time = 0.f, .queued = false, .dirty = false });
+	}
+
+	if(!entries[ent].dirty){
+		entries[ent].dirty = true;
+		dirty.emplace_back(ent);
+	}
+}
+
+void QC_VM_ThinkQueue::flush(const QC_VM_EntityStore &ents){
+	for(const auto ent : dirty){
+		auto &entry = entries[ent];
+		entry.dirty = false;
+
+		const auto time = ents.isLive(ent) ? ents.slot(ent, field).f32 : 0.f;
+
+		if(time > 0.f && !(entry.queued && entry.time == time)){
+			heap.emplace_back(Item{ .time = time, .ent = ent });
+			std::push_heap(heap.begin(), heap.end(), std::greater<Item>());
+		}
+
+		entry.time = time;
+		entry.queued = time > 0.f;
+	}
+
+	dirty.clear();
+}
+
+bool QC_VM_ThinkQueue::pop(QC_Float time, QC_Uint32 *entRet, QC_Float *timeRet){
+	while(!heap.empty() && heap.front().time <= time){
+		const auto item = heap.front();
+		std::pop_heap(heap.begin(), heap.end(), std::greater<Item>());
+		heap.pop_back();
+
+		auto &entry = entries[item.ent];
+		if(!entry.queued || entry.time != item.time){
+			continue;
+		}
+
+		entry.queued = false;
+		*entRet = item.ent;
+		*timeRet = item.time;
+		return true;
+	}
+
+	return false;
+}
+
+static QC_VM_FindIndex &qcvm_addFindIndex(QC_VM_EntityStore &ents, QC_Uint32 field){
+	auto &index = ents.findIndices.emplace_back();
+	index.field = field;
+
+	ents.fieldWatch[field] |= QCVM_WATCH_FIND;
+
+	index.markDirty(0);
+	for(auto ent = ents.nextLive(0); ent; ent = ents.nextLive(ent)) index.markDirty(ent);
+
+	return index;
+}
+
+extern "C" {
+
+// current value of the `time` global, entities are freed and reused by game time like in Quake
+static inline QC_Float qcvm_entityTime(const QC_VM *vm){
+	const auto res = vm->globals.find("time");
+	return res && res->type == QC_BYTECODE_TYPE_FLOAT ? vm->globalMem[res->slot].f32 : 0.f;
+}
+
+static inline const QC_VM_Global *qcvm_findField(const QC_VM *vm, QC_Entity ent, const char *name, size_t nameLen){
+	if(!vm->ents.isValid(ent)){
+		qcLogError("invalid entity handle 0x%zx", size_t(ent));
+		return nullptr;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return nullptr;
+	}
+
+	const auto res = vm->fields.find(std::string_view(name, nameLen));
+	if(!res){
+		qcLogError("field '%.*s' not found", int(nameLen), name);
+		return nullptr;
+	}
+
+	return res;
+}
+
+bool qcVMSpawnEntity(QC_VM *vm, QC_Entity *ret){
+	if(!vm || !ret){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+
+	const auto ent = vm->ents.spawn(qcvm_entityTime(vm));
+	if(ent == 0){
+		return false;
+	}
+
+	*ret = vm->ents.handle(ent);
+	return true;
+}
+
+bool qcVMRemoveEntity(QC_VM *vm, QC_Entity ent){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(qcEntityIndex(ent) == 0){
+		qcLogError("can not remove the world entity");
+		return false;
+	}
+	else if(!vm->ents.isValid(ent)){
+		qcLogError("invalid entity handle 0x%zx", size_t(ent));
+		return false;
+	}
+
+	vm->ents.remove(qcEntityIndex(ent), qcvm_entityTime(vm));
+	return true;
+}
+
+bool qcVMEntityHandle(const QC_VM *vm, QC_Uint32 index, QC_Entity *ret){
+	if(!vm || !ret){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+	else if(!vm->ents.isLive(index)){
+		return false;
+	}
+
+	*ret = vm->ents.handle(index);
+	return true;
+}
+
+static QC_Uint32 qcvm_vectorField(const QC_VM *vm, std::string_view name){
+	const auto res = vm->fields.find(name);
+	return res && res->type == QC_BYTECODE_TYPE_VECTOR ? res->slot : QCVM_NO_ENTITY;
+}
+
+QC_Entity qcvm_findRadius(QC_VM *vm, QC_Vector org, QC_Float rad){
+	auto &ents = vm->ents;
+
+	const auto chain = vm->fields.find("chain");
+	if(!chain || chain->type != QC_BYTECODE_TYPE_ENTITY){
+		qcLogError("findradius needs an entity field named 'chain'");
+		return 0;
+	}
+
+	thread_local std::vector<QC_Uint32> found;
+	found.clear();
+
+	if(ents.spatial.field != QCVM_NO_ENTITY){
+		ents.spatial.query(ents, org, rad, found);
+		std::sort(found.begin(), found.end());
+	}
+	else if(const auto origin = qcvm_vectorField(vm, "origin"); origin != QCVM_NO_ENTITY){
+		const auto mins = qcvm_vectorField(vm, "mins");
+		const auto maxs = qcvm_vectorField(vm, "maxs");
+
+		for(auto i = ents.nextLive(0); i; i = ents.nextLive(i)){
+			if(qcvm_inRadius(qcvm_radiusPoint(ents, i, origin, mins, maxs), org, rad * rad)){
+				found.emplace_back(i);
+			}
+		}
+	}
+
+	// linked the same way as walking every edict in order, so the last match comes first
+	QC_Uint32 head = 0;
+
+	for(const auto ent : found){
+		ents.touch(ent, chain->slot);
+		ents.slot(ent, chain->slot).u32 = head;
+		head = ent;
+	}
+
+	return ents.handle(head);
+}
+
+QC_Entity qcvm_find(QC_VM *vm, QC_Entity start, QC_Uint32 field, QC_String match){
+	auto &ents = vm->ents;
+
+	if(field >= ents.stride){
+		qcLogError("invalid field offset %u", field);
+		return 0;
+	}
+
+	const auto matchStr = match ? qcString(vm->strBuf, match) : QC_EMPTY_STRVIEW;
+	const auto matchView = matchStr.ptr ? std::string_view(matchStr.ptr, matchStr.len) : std::string_view();
+
+	auto index = ents.findIndex(field);
+
+	if(!index && ents.findAutoIndex && ++ents.findScans[field] >= ents.findAutoIndex){
+		index = &qcvm_addFindIndex(ents, field);
+	}
+
+	if(index){
+		index->flush(ents, vm->strBuf);
+		return ents.handle(index->next(qcEntityIndex(start), matchView));
+	}
+
+	for(auto i = ents.nextLive(qcEntityIndex(start)); i; i = ents.nextLive(i)){
+		const auto s = ents.slot(i, field).u32;
+		const auto str = s ? qcString(vm->strBuf, s) : QC_EMPTY_STRVIEW;
+
+		if((str.ptr ? std::string_view(str.ptr, str.len) : std::string_view()) == matchView){
+			return ents.handle(i);
+		}
+	}
+
+	return 0;
+}
+
+void qcvm_resolveThinkDefs(QC_VM *vm){
+	const auto lookup = [](const QC_VM_SymbolTable<QC_VM_Global> &table, std::string_view name, QC_Uint32 type){
+		const auto res = table.find(name);
+		return res && res->type == type ? res->slot : QCVM_NO_ENTITY;
+	};
+
+	auto &defs = vm->thinkDefs;
+	defs.self = lookup(vm->globals, "self", QC_BYTECODE_TYPE_ENTITY);
+	defs.other = lookup(vm->globals, "other", QC_BYTECODE_TYPE_ENTITY);
+	defs.time = lookup(vm->globals, "time", QC_BYTECODE_TYPE_FLOAT);
+	defs.frame = lookup(vm->fields, "frame", QC_BYTECODE_TYPE_FLOAT);
+	defs.think = lookup(vm->fields, "think", QC_BYTECODE_TYPE_FUNC);
+	defs.nextthink = lookup(vm->fields, "nextthink", QC_BYTECODE_TYPE_FLOAT);
+}
+
+bool qcVMRunThinks(QC_VM *vm, QC_Float time){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	const auto &defs = vm->thinkDefs;
+	if(defs.self == QCVM_NO_ENTITY || defs.time == QCVM_NO_ENTITY || defs.think == QCVM_NO_ENTITY || defs.nextthink == QCVM_NO_ENTITY){
+		qcLogError("running thinks needs 'self' and 'time' globals and 'think' and 'nextthink' fields");
+		return false;
+	}
+	else if(!vm->ents.reserve()){
+		return false;
+	}
+
+	auto &ents = vm->ents;
+	auto &thinks = ents.thinks;
+
+	// start watching on first use, then every nextthink write keeps the queue current
+	if(thinks.field == QCVM_NO_ENTITY){
+		thinks.field = defs.nextthink;
+		ents.fieldWatch[defs.nextthink] |= QCVM_WATCH_THINK;
+
+		thinks.markDirty(0);
+		for(auto ent = ents.nextLive(0); ent; ent = ents.nextLive(ent)) thinks.markDirty(ent);
+	}
+
+	// like a server frame, everything due now thinks once and anything it schedules waits for the next call
+	thread_local std::vector<QC_VM_ThinkQueue::Item> due;
+	due.clear();
+
+	thinks.flush(ents);
+
+	QC_VM_ThinkQueue::Item item;
+	while(thinks.pop(time, &item.ent, &item.time)){
+		due.emplace_back(item);
+	}
+
+	const auto frameStart = vm->globalMem[defs.time].f32;
+
+	for(const auto &[thinkTime, ent] : due){
+		// removed or rescheduled by an earlier think
+		thinks.flush(ents);
+		if(!ents.isLive(ent) || thinks.entries[ent].queued){
+			continue;
+		}
+
+		const auto fnIdx = ents.slot(ent, defs.think).u32;
+
+		ents.touch(ent, defs.nextthink);
+		ents.slot(ent, defs.nextthink).f32 = 0.f;
+
+		if(fnIdx == 0){
+			continue;
+		}
+
+		// natives may load more bytecode and move the globals
+		const auto g = vm->globalMem.data();
+		g[defs.time].f32 = QC_MAX(thinkTime, frameStart);
+		g[defs.self].u32 = ent;
+		if(defs.other != QCVM_NO_ENTITY) g[defs.other].u32 = 0;
+
+		QC_Value ret;
+		if(!qcvm_execLinked(vm, fnIdx, 0, nullptr, &ret)){
+			return false;
+		}
+	}
+
+	vm->globalMem[defs.time].f32 = time;
+	return true;
+}
+
+QC_Entity qcvm_nextEnt(QC_VM *vm, QC_Entity ent){
+	return vm->ents.handle(vm->ents.nextLive(qcEntityIndex(ent)));
+}
+
+bool qcVMSetFindIndex(QC_VM *vm, const char *name, size_t nameLen, bool enable){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+
+	const auto field = vm->fields.find(std::string_view(name, nameLen));
+	if(!field || field->type != QC_BYTECODE_TYPE_STRING){
+		qcLogError("no string field named '%.*s' has been loaded", int(nameLen), name);
+		return false;
+	}
+
+	auto &ents = vm->ents;
+	const auto index = ents.findIndex(field->slot);
+
+	if(enable && !index){
+		qcvm_addFindIndex(ents, field->slot);
+	}
+	else if(!enable && index){
+		ents.fieldWatch[field->slot] &= ~QCVM_WATCH_FIND;
+		ents.findIndices.erase(ents.findIndices.begin() + (index - ents.findIndices.data()));
+	}
+
+	return true;
+}
+
+bool qcVMSetFindAutoIndex(QC_VM *vm, QC_Uint32 calls){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	vm->ents.findAutoIndex = calls;
+	vm->ents.findScans.clear();
+	return true;
+}
+
+bool qcVMSetSpatialIndex(QC_VM *vm, QC_Float cellSize){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!(cellSize >= 0.f)){
+		qcLogError("invalid cell size %f", double(cellSize));
+		return false;
+	}
+
+	auto &ents = vm->ents;
+	auto &spatial = ents.spatial;
+
+	const auto watchVector = [&ents](QC_Uint32 field, bool watch){
+		if(field == QCVM_NO_ENTITY) return;
+
+		for(QC_Uint32 i = 0; i < 3; i++){
+			if(watch) ents.fieldWatch[field + i] |= QCVM_WATCH_SPATIAL;
+			else ents.fieldWatch[field + i] &= ~QCVM_WATCH_SPATIAL;
+		}
+	};
+
+	if(spatial.field != QCVM_NO_ENTITY){
+		watchVector(spatial.field, false);
+		watchVector(spatial.mins, false);
+		watchVector(spatial.maxs, false);
+		spatial = QC_VM_SpatialIndex{};
+	}
+
+	if(cellSize == 0.f){
+		return true;
+	}
+
+	const auto origin = qcvm_vectorField(vm, "origin");
+	if(origin == QCVM_NO_ENTITY){
+		qcLogError("no vector field named 'origin' has been loaded");
+		return false;
+	}
+
+	spatial.field = origin;
+	spatial.cellSize = cellSize;
+
+	// indexed on the same point findradius measures from without the grid
+	if(const auto mins = qcvm_vectorField(vm, "mins"), maxs = qcvm_vectorField(vm, "maxs"); mins != QCVM_NO_ENTITY && maxs != QCVM_NO_ENTITY){
+		spatial.mins = mins;
+		spatial.maxs = maxs;
+	}
+
+	watchVector(spatial.field, true);
+	watchVector(spatial.mins, true);
+	watchVector(spatial.maxs, true);
+
+	for(auto ent = ents.nextLive(0); ent; ent = ents.nextLive(ent)){
+		spatial.markDirty(ent);
+	}
+
+	return true;
+}
+
+bool qcVMSetEntityReuseDelay(QC_VM *vm, QC_Float seconds){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!(seconds >= 0.f)){
+		qcLogError("invalid entity reuse delay %f", double(seconds));
+		return false;
+	}
+
+	vm->ents.reuseDelay = seconds;
+	return true;
+}
+
+QC_Uint32 qcVMNumEntityFields(const QC_VM *vm){
+	return vm ? vm->ents.stride : 0;
+}
+
+bool qcVMGetField(const QC_VM *vm, QC_Entity ent, const char *name, size_t nameLen, QC_VM_Value *ret){
+	if(!vm || !ret){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+
+	const auto field = qcvm_findField(vm, ent, name, nameLen);
+	if(!field){
+		return false;
+	}
+
+	ret->type = field->type;
+	std::memset(&ret->value, 0, sizeof(ret->value));
+
+	const auto dst = reinterpret_cast<QC_VM_Slot*>(&ret->value);
+	for(QC_Uint32 i = 0; i < qcvm_typeSlots(field->type); i++){
+		dst[i] = vm->ents.slot(qcEntityIndex(ent), field->slot + i);
+	}
+
+	return true;
+}
+
+bool qcVMSetField(QC_VM *vm, QC_Entity ent, const char *name, size_t nameLen, QC_VM_Value value){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	const auto field = qcvm_findField(vm, ent, name, nameLen);
+	if(!field){
+		return false;
+	}
+	else if(value.type != field->type){
+		qcLogError("wrong type 0x%x for field '%.*s' (expected 0x%x)", value.type, int(nameLen), name, field->type);
+		return false;
+	}
+
+	const auto src = reinterpret_cast<const QC_VM_Slot*>(&value.value);
+	for(QC_Uint32 i = 0; i < qcvm_typeSlots(field->type); i++){
+		if(vm->ents.fieldWatch[field->slot + i]) vm->ents.touch(qcEntityIndex(ent), field->slot + i);
+		vm->ents.slot(qcEntityIndex(ent), field->slot + i) = src[i];
+	}
+
+	return true;
+}
+
+bool qcVMFieldOffset(const QC_VM *vm, const char *name, size_t nameLen, QC_Uint32 *ret){
+	if(!vm || !ret){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+
+	const auto field = vm->fields.find(std::string_view(name, nameLen));
+	if(!field){
+		qcLogError("field '%.*s' not found", int(nameLen), name);
+		return false;
+	}
+
+	*ret = field->slot;
+	return true;
+}
+
+bool qcVMSetChangeTracking(QC_VM *vm, bool enabled){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	auto &ents = vm->ents;
+	if(ents.changes.enabled == enabled){
+		return true;
+	}
+
+	for(auto &watch : ents.fieldWatch){
+		if(enabled) watch |= QCVM_WATCH_CHANGES;
+		else watch &= ~QCVM_WATCH_CHANGES;
+	}
+
+	const auto seq = ents.changes.seq;
+	ents.changes = QC_VM_ChangeLog{};
+	ents.changes.enabled = enabled;
+	ents.changes.seq = seq;
+	return true;
+}
+
+QC_Uint32 qcVMChangeSeq(const QC_VM *vm){
+	return vm ? vm->ents.changes.seq : 0;
+}
+
+QC_Uint32 qcVMAdvanceChangeSeq(QC_VM *vm){
+	return vm ? ++vm->ents.changes.seq : 0;
+}
+
+bool qcVMForEachChange(const QC_VM *vm, QC_Uint32 sinceSeq, QC_VM_ChangeFn fn, void *user){
+	if(!vm || !fn){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+
+	const auto &changes = vm->ents.changes;
+
+	for(const auto ent : changes.changed){
+		const auto &entry = changes.entries[ent];
+		if(entry.seq < sinceSeq) continue;
+
+		for(QC_Uint32 w = 0; w < entry.bits.size(); w++){
+			for(auto word = entry.bits[w]; word; word &= word - 1){
+				const auto field = (w * 64u) + QC_Uint32(std::countr_zero(word));
+				if(entry.fieldSeq[field] >= sinceSeq) fn(user, ent, field);
+			}
+		}
+	}
+
+	return true;
+}
+
+bool qcVMClearChanges(QC_VM *vm, QC_Uint32 beforeSeq){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	vm->ents.changes.clear(beforeSeq);
+	return true;
+}
+
+QC_Uint32 qcVMNumEntities(const QC_VM *vm){
+	return vm ? vm->ents.numEnts : 0;
+}
+
+const QC_Uint32 *qcVMLiveEntities(const QC_VM *vm, size_t *numRet){
+	if(!vm || !numRet){
+		qcLogError("NULL argument passed");
+		return nullptr;
+	}
+
+	const auto &ents = vm->ents;
+
+	if(ents.liveListStale){
+		ents.liveList.clear();
+		for(auto ent = ents.nextLive(0); ent; ent = ents.nextLive(ent)) ents.liveList.emplace_back(ent);
+		ents.liveListStale = false;
+	}
+
+	*numRet = ents.liveList.size();
+	return ents.liveList.data();
+}
+
+void *qcVMFieldData(QC_VM *vm, const char *name, size_t nameLen, QC_Uintptr *entityStrideRet, QC_Uintptr *componentStrideRet){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return nullptr;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return nullptr;
+	}
+
+	const auto field = vm->fields.find(std::string_view(name, nameLen));
+	if(!field){
+		qcLogError("field '%.*s' not found", int(nameLen), name);
+		return nullptr;
+	}
+	else if(!vm->ents.reserve()){
+		return nullptr;
+	}
+
+	if(entityStrideRet) *entityStrideRet = vm->ents.entStep;
+	if(componentStrideRet) *componentStrideRet = vm->ents.fieldStep;
+
+	return &vm->ents.slot(0, field->slot);
+}
+
+}
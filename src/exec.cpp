@@ -0,0 +1,696 @@
+#define QCVM_IMPLEMENTATION
+
+#include "qcvm/vm_impl.hpp"
+#include "qcvm/fastmath.hpp"
+
+#include <cmath>
+#include <type_traits>
+
+#define QCVM_STACK_MAX_FRAMES (1u << 16u)
+#define QCVM_STACK_MAX_LOCALS (1u << 22u)
+
+#if defined(__GNUC__)
+#define QCVM_ASSUME(cond) do{ if(!(cond)) __builtin_unreachable(); } while(0)
+#elif defined(_MSC_VER)
+#define QCVM_ASSUME(cond) __assume(cond)
+#else
+#define QCVM_ASSUME(cond) ((void)0)
+#endif
+
+extern "C" {
+
+static inline QC_StrView qcvm_slotString(const QC_VM *vm, QC_Uint32 s){
+	if(s == 0){
+		return QC_StrView{ "", 0 };
+	}
+
+	const auto str = qcString(vm->strBuf, s);
+	return str.ptr ? str : QC_StrView{ "", 0 };
+}
+
+// every entity field write from bytecode goes through here, so indices over watched fields see it
+static inline void qcvm_storeField(QC_VM_EntityStore *ents, QC_Uint32 ent, QC_Uint32 field, QC_VM_Slot value){
+	if(ents->fieldWatch[field]) [[unlikely]] ents->touch(ent, field);
+	ents->slot(ent, field) = value;
+}
+
+// arena index of an `n` slot field of \p ent
+static inline bool qcvm_fieldAddress(const QC_VM_EntityStore *ents, QC_Uint32 ent, QC_Uint32 field, QC_Uint32 n, QC_Uint32 *ret){
+	if(ent >= ents->numEnts || field >= ents->stride || (ents->stride - field) < n){
+		return false;
+	}
+
+	*ret = ents->address(ent, field);
+	return true;
+}
+
+static inline bool qcvm_enterFn(QC_VM *vm, QC_Uint32 fnIdx, QC_Uint32 returnStmt){
+	const auto fn = &vm->fnTable[fnIdx];
+	const auto g = vm->globalMem.data();
+	const QC_VM_Frame frame = { .stmt = returnStmt, .fnIdx = fnIdx, .localBase = vm->localStack.size() };
+
+	// locals are saved before the frame is pushed so every pushed frame is complete if either overflows
+	if(!vm->localStack.push(g + fn->localIdx, fn->numLocals) || !vm->frames.push(frame)){
+		qcLogError("stack overflow");
+		return false;
+	}
+
+	auto dst = fn->localIdx;
+
+	for(QC_Uint32 i = 0; i < fn->numArgs; i++){
+		for(QC_Int8 j = 0; j < fn->argSizes[i]; j++){
+			g[dst++] = g[QCVM_OFS_PARM0 + (i * 3) + j];
+		}
+	}
+
+	return true;
+}
+
+static inline QC_Uint32 qcvm_leaveFn(QC_VM *vm){
+	const auto frame = vm->frames.back();
+	const auto fn = &vm->fnTable[frame.fnIdx];
+
+	std::memcpy(vm->globalMem.data() + fn->localIdx, vm->localStack.data() + frame.localBase, fn->numLocals * sizeof(QC_VM_Slot));
+	vm->localStack.truncate(frame.localBase);
+
+	vm->frames.pop();
+	return frame.stmt;
+}
+
+static inline void qcvm_parmArgs(const QC_VM *vm, QC_Uint32 argc, QC_Value *args){
+	for(QC_Uint32 i = 0; i < argc; i++){
+		std::memset(args + i, 0, sizeof(QC_Value));
+		std::memcpy(args + i, vm->globalMem.data() + QCVM_OFS_PARM0 + (i * 3), 3 * sizeof(QC_VM_Slot));
+	}
+}
+
+static inline bool qcvm_callNative(QC_VM *vm, const QC_VM_FnStorage *callee){
+	const QC_VM_Fn *fn = &callee->base;
+
+	if(fn->type == QC_VM_FN_BUILTIN){
+		const auto builtin = qcvm_findBuiltin(vm, callee->builtin.index);
+		if(!builtin){
+			qcLogError("builtin %u is not set", callee->builtin.index);
+			return false;
+		}
+
+		fn = QCVM_SUPER2(builtin);
+	}
+
+	QC_Value args[8], ret;
+	qcvm_parmArgs(vm, 8, args);
+
+	if(fn->flags & QC_FUNCTION_PURE){
+		// goes through the memo
+		if(!qcVMExec(vm, fn, reinterpret_cast<const QC_VM_Fn_Native*>(fn)->nParams, args, &ret)){
+			return false;
+		}
+	}
+	else if(!qcVMExecNative_unsafe(vm, reinterpret_cast<const QC_VM_Fn_Native*>(fn), reinterpret_cast<const QC_VM_Fn_Native*>(fn)->nParams, args, &ret)){
+		return false;
+	}
+
+	std::memcpy(vm->globalMem.data() + QCVM_OFS_RETURN, &ret, 3 * sizeof(QC_VM_Slot));
+	return true;
+}
+
+static inline void qcvm_unwind(QC_VM *vm, QC_Uint32 depth, QC_Uint32 localDepth){
+	while(vm->frames.size() > depth){
+		qcvm_leaveFn(vm);
+	}
+
+	vm->localStack.truncate(localDepth);
+}
+
+static bool qcvm_reserveStacks(QC_VM *vm){
+#ifdef QCVM_STACK_GUARD_PAGES
+	if(!qcvm_installStackGuard()){
+		return false;
+	}
+#endif
+
+	if(!vm->frames.base && !vm->frames.reserve(QCVM_STACK_MAX_FRAMES)){
+		return false;
+	}
+
+	return vm->localStack.reserve(QCVM_STACK_MAX_LOCALS);
+}
+
+static void qcvm_profileStmt(QC_VM *vm, QC_Uint32 pc){
+	const auto st = vm->code.data() + pc;
+	const auto operands = qcvm_opGlobalOperands(st->op);
+	const QC_Uint32 slots[] = { st->a, st->b, st->c };
+
+	++vm->stmtProfile[pc].hits;
+
+	for(QC_Uint32 i = 0; i < 3; i++){
+		if((operands & (1u << i)) && slots[i] < vm->globalProfile.size()){
+			++vm->globalProfile[slots[i]];
+		}
+	}
+}
+
+}
+
+template<typename Stmt>
+static inline const Stmt *qcvm_stmts(const QC_VM *vm){
+	if constexpr(std::is_same_v<Stmt, QC_ByteCodeStatement16>){
+		return vm->compactCode.data();
+	}
+	else{
+		return vm->code.data();
+	}
+}
+
+/**
+ * Interpreter loop for the opcodes of \p Dialect, reading statements from the image of type \p Stmt.
+ * Every linked statement is known to be within the dialect, so smaller dialects get a smaller dispatch table.
+ */
+template<QC_VM_Dialect Dialect, typename Stmt>
+static bool qcvm_interpret(QC_VM *vm, QC_Uint32 pc, QC_Uint32 exitDepth, QC_Value *ret){
+	constexpr bool compact = std::is_same_v<Stmt, QC_ByteCodeStatement16>;
+	using Offset = std::conditional_t<compact, QC_Int16, QC_Int32>;
+
+	auto g = vm->globalMem.data();
+
+	// the arena never moves, but its stride grows when modules are loaded
+	const auto ents = &vm->ents;
+
+	// checked once per statement
+	auto profiling = vm->profiling;
+	const auto fastMath = vm->fastMath;
+	const auto checkPointers = vm->checkPointers;
+
+#define QCVM_A (g + st->a)
+#define QCVM_B (g + st->b)
+#define QCVM_C (g + st->c)
+
+#define QCVM_FAIL(...) \
+	do{ \
+		qcLogError(__VA_ARGS__); \
+		return false; \
+	} while(0)
+
+#define QCVM_BRANCH(cond, offset) \
+	do{ \
+		const bool taken_ = (cond); \
+		if(profiling) [[unlikely]] vm->stmtProfile[pc].taken += taken_; \
+		pc += taken_ ? QC_Int32(Offset(offset)) : 1; \
+	} while(0)
+
+// after anything that may link or decode more code
+#define QCVM_CHECK_IMAGE(nextPc) \
+	do{ \
+		if constexpr(Dialect != QCVM_DIALECT_FULL || compact){ \
+			if(vm->dialect > Dialect || (compact && !vm->compactValid.load(std::memory_order_relaxed))) [[unlikely]]{ \
+				return qcvm_interpret<QCVM_DIALECT_FULL, QC_ByteCodeStatement32>(vm, (nextPc), exitDepth, ret); \
+			} \
+		} \
+	} while(0)
+
+	for(;;){
+		const auto st = qcvm_stmts<Stmt>(vm) + pc;
+
+		if(profiling) [[unlikely]] qcvm_profileStmt(vm, pc);
+
+		if constexpr(Dialect != QCVM_DIALECT_FULL){
+			QCVM_ASSUME(st->op <= qcvm_dialectMaxOp(Dialect));
+		}
+
+		switch(st->op){
+			case QC_OP_DONE:
+			case QC_OP_RETURN:{
+				g[QCVM_OFS_RETURN] = QCVM_A[0];
+				g[QCVM_OFS_RETURN + 1] = QCVM_A[1];
+				g[QCVM_OFS_RETURN + 2] = QCVM_A[2];
+
+				pc = qcvm_leaveFn(vm);
+
+				if(vm->frames.size() == exitDepth){
+					std::memset(ret, 0, sizeof(QC_Value));
+					std::memcpy(ret, g + QCVM_OFS_RETURN, 3 * sizeof(QC_VM_Slot));
+					return true;
+				}
+
+				continue;
+			}
+
+			case QC_OP_GOTO:{
+				QCVM_BRANCH(true, st->a);
+				continue;
+			}
+
+			case QC_OP_IF: QCVM_BRANCH(QCVM_A->u32, st->b); continue;
+			case QC_OP_IFNOT: QCVM_BRANCH(!QCVM_A->u32, st->b); continue;
+			case QC_OP_IF_S: QCVM_BRANCH(qcvm_slotString(vm, QCVM_A->u32).len, st->b); continue;
+			case QC_OP_IFNOT_S: QCVM_BRANCH(!qcvm_slotString(vm, QCVM_A->u32).len, st->b); continue;
+
+			// Arithmetic
+
+			case QC_OP_MUL_F: QCVM_C->f32 = QCVM_A->f32 * QCVM_B->f32; break;
+			case QC_OP_MUL_V:{
+				if(fastMath){
+					QCVM_C->f32 = qcvm::fastDot3(QCVM_A[0].f32, QCVM_A[1].f32, QCVM_A[2].f32, QCVM_B[0].f32, QCVM_B[1].f32, QCVM_B[2].f32);
+				}
+				else{
+					QCVM_C->f32 = QCVM_A[0].f32 * QCVM_B[0].f32 + QCVM_A[1].f32 * QCVM_B[1].f32 + QCVM_A[2].f32 * QCVM_B[2].f32;
+				}
+				break;
+			}
+
+			case QC_OP_MUL_FV:{
+				const auto f = QCVM_A->f32;
+				QCVM_C[0].f32 = f * QCVM_B[0].f32;
+				QCVM_C[1].f32 = f * QCVM_B[1].f32;
+				QCVM_C[2].f32 = f * QCVM_B[2].f32;
+				break;
+			}
+
+			case QC_OP_MUL_VF:{
+				const auto f = QCVM_B->f32;
+				QCVM_C[0].f32 = QCVM_A[0].f32 * f;
+				QCVM_C[1].f32 = QCVM_A[1].f32 * f;
+				QCVM_C[2].f32 = QCVM_A[2].f32 * f;
+				break;
+			}
+
+			case QC_OP_DIV_F: QCVM_C->f32 = fastMath ? QCVM_A->f32 * qcvm::fastRcp(QCVM_B->f32) : QCVM_A->f32 / QCVM_B->f32; break;
+
+			case QC_OP_DIV_VF:{
+				const auto f = QCVM_B->f32;
+
+				if(fastMath){
+					const auto r = qcvm::fastRcp(f);
+					QCVM_C[0].f32 = QCVM_A[0].f32 * r;
+					QCVM_C[1].f32 = QCVM_A[1].f32 * r;
+					QCVM_C[2].f32 = QCVM_A[2].f32 * r;
+					break;
+				}
+
+				QCVM_C[0].f32 = QCVM_A[0].f32 / f;
+				QCVM_C[1].f32 = QCVM_A[1].f32 / f;
+				QCVM_C[2].f32 = QCVM_A[2].f32 / f;
+				break;
+			}
+
+			case QC_OP_ADD_F: QCVM_C->f32 = QCVM_A->f32 + QCVM_B->f32; break;
+
+			case QC_OP_ADD_V:{
+				QCVM_C[0].f32 = QCVM_A[0].f32 + QCVM_B[0].f32;
+				QCVM_C[1].f32 = QCVM_A[1].f32 + QCVM_B[1].f32;
+				QCVM_C[2].f32 = QCVM_A[2].f32 + QCVM_B[2].f32;
+				break;
+			}
+
+			case QC_OP_SUB_F: QCVM_C->f32 = QCVM_A->f32 - QCVM_B->f32; break;
+
+			case QC_OP_SUB_V:{
+				QCVM_C[0].f32 = QCVM_A[0].f32 - QCVM_B[0].f32;
+				QCVM_C[1].f32 = QCVM_A[1].f32 - QCVM_B[1].f32;
+				QCVM_C[2].f32 = QCVM_A[2].f32 - QCVM_B[2].f32;
+				break;
+			}
+
+			// Comparison
+
+			case QC_OP_EQ_F: QCVM_C->f32 = QCVM_A->f32 == QCVM_B->f32; break;
+
+			case QC_OP_EQ_V:{
+				QCVM_C->f32 = QCVM_A[0].f32 == QCVM_B[0].f32 && QCVM_A[1].f32 == QCVM_B[1].f32 && QCVM_A[2].f32 == QCVM_B[2].f32;
+				break;
+			}
+
+			case QC_OP_EQ_S: QCVM_C->f32 = qcvm_slotString(vm, QCVM_A->u32) == qcvm_slotString(vm, QCVM_B->u32); break;
+
+			case QC_OP_EQ_E:
+			case QC_OP_EQ_FNC:
+				QCVM_C->f32 = QCVM_A->u32 == QCVM_B->u32;
+				break;
+
+			case QC_OP_NE_F: QCVM_C->f32 = QCVM_A->f32 != QCVM_B->f32; break;
+
+			case QC_OP_NE_V:{
+				QCVM_C->f32 = QCVM_A[0].f32 != QCVM_B[0].f32 || QCVM_A[1].f32 != QCVM_B[1].f32 || QCVM_A[2].f32 != QCVM_B[2].f32;
+				break;
+			}
+
+			case QC_OP_NE_S: QCVM_C->f32 = qcvm_slotString(vm, QCVM_A->u32) != qcvm_slotString(vm, QCVM_B->u32); break;
+
+			case QC_OP_NE_E:
+			case QC_OP_NE_FNC:
+				QCVM_C->f32 = QCVM_A->u32 != QCVM_B->u32;
+				break;
+
+			case QC_OP_LE: QCVM_C->f32 = QCVM_A->f32 <= QCVM_B->f32; break;
+			case QC_OP_GE: QCVM_C->f32 = QCVM_A->f32 >= QCVM_B->f32; break;
+			case QC_OP_LT: QCVM_C->f32 = QCVM_A->f32 < QCVM_B->f32; break;
+			case QC_OP_GT: QCVM_C->f32 = QCVM_A->f32 > QCVM_B->f32; break;
+
+			// Storing
+
+			case QC_OP_STORE_F:
+			case QC_OP_STORE_S:
+			case QC_OP_STORE_ENT:
+			case QC_OP_STORE_FLD:
+			case QC_OP_STORE_FNC:
+			case QC_OP_STORE_I:
+				*QCVM_B = *QCVM_A;
+				break;
+
+			case QC_OP_STORE_V:{
+				QCVM_B[0] = QCVM_A[0];
+				QCVM_B[1] = QCVM_A[1];
+				QCVM_B[2] = QCVM_A[2];
+				break;
+			}
+
+			case QC_OP_STORE_IF: QCVM_B->f32 = QC_Float(QCVM_A->i32); break;
+			case QC_OP_STORE_FI: QCVM_B->i32 = QC_Int32(QCVM_A->f32); break;
+
+			// Entities
+
+			case QC_OP_LOAD_F:
+			case QC_OP_LOAD_S:
+			case QC_OP_LOAD_ENT:
+			case QC_OP_LOAD_FLD:
+			case QC_OP_LOAD_FNC:{
+				QC_Uint32 addr;
+				if(!qcvm_fieldAddress(ents, QCVM_A->u32, QCVM_B->u32, 1, &addr)){
+					QCVM_FAIL("statement %u reads field %u of invalid entity %u", pc, QCVM_B->u32, QCVM_A->u32);
+				}
+
+				*QCVM_C = ents->base[addr];
+				break;
+			}
+
+			case QC_OP_LOAD_V:{
+				QC_Uint32 addr;
+				if(!qcvm_fieldAddress(ents, QCVM_A->u32, QCVM_B->u32, 3, &addr)){
+					QCVM_FAIL("statement %u reads field %u of invalid entity %u", pc, QCVM_B->u32, QCVM_A->u32);
+				}
+
+				const auto step = ents->fieldStep;
+				QCVM_C[0] = ents->base[addr];
+				QCVM_C[1] = ents->base[addr + step];
+				QCVM_C[2] = ents->base[addr + (2 * step)];
+				break;
+			}
+
+			case QC_OP_ADDRESS:{
+				if(QCVM_A->u32 >= ents->numEnts || QCVM_B->u32 >= ents->stride){
+					QCVM_FAIL("statement %u takes the address of field %u of invalid entity %u", pc, QCVM_B->u32, QCVM_A->u32);
+				}
+
+				ents->ptrsTaken = true;
+				QCVM_C->u32 = ents->fieldPtr(QCVM_A->u32, QCVM_B->u32);
+				break;
+			}
+
+			case QC_OP_STOREP_F:
+			case QC_OP_STOREP_S:
+			case QC_OP_STOREP_ENT:
+			case QC_OP_STOREP_FLD:
+			case QC_OP_STOREP_FNC:{
+				const auto ptr = QCVM_B->u32;
+				if(checkPointers && !ents->validPtr(ptr, 1)) [[unlikely]]{
+					QCVM_FAIL("statement %u stores through invalid pointer 0x%x", pc, ptr);
+				}
+
+				qcvm_storeField(ents, ents->ptrEntity(ptr), ents->ptrField(ptr), *QCVM_A);
+				break;
+			}
+
+			case QC_OP_STOREP_V:{
+				const auto ptr = QCVM_B->u32;
+				if(checkPointers && !ents->validPtr(ptr, 3)) [[unlikely]]{
+					QCVM_FAIL("statement %u stores through invalid pointer 0x%x", pc, ptr);
+				}
+
+				const auto ent = ents->ptrEntity(ptr), field = ents->ptrField(ptr);
+				qcvm_storeField(ents, ent, field, QCVM_A[0]);
+				qcvm_storeField(ents, ent, field + 1, QCVM_A[1]);
+				qcvm_storeField(ents, ent, field + 2, QCVM_A[2]);
+				break;
+			}
+
+			// self.frame = a, self.think = b, self.nextthink = time + 0.1
+			case QC_OP_STATE:{
+				const auto &defs = vm->thinkDefs;
+				if(defs.self == QCVM_NO_ENTITY || defs.time == QCVM_NO_ENTITY || defs.frame == QCVM_NO_ENTITY || defs.think == QCVM_NO_ENTITY || defs.nextthink == QCVM_NO_ENTITY){
+					QCVM_FAIL("statement %u needs 'self', 'time', 'frame', 'think' and 'nextthink'", pc);
+				}
+
+				const auto self = g[defs.self].u32;
+				if(self >= ents->numEnts){
+					QCVM_FAIL("statement %u sets the state of invalid entity %u", pc, self);
+				}
+
+				qcvm_storeField(ents, self, defs.frame, *QCVM_A);
+				qcvm_storeField(ents, self, defs.think, *QCVM_B);
+				qcvm_storeField(ents, self, defs.nextthink, QC_VM_Slot{ .f32 = g[defs.time].f32 + 0.1f });
+				break;
+			}
+
+			// a.nextthink = time + b
+			case QC_OP_THINKTIME:{
+				const auto &defs = vm->thinkDefs;
+				if(defs.time == QCVM_NO_ENTITY || defs.nextthink == QCVM_NO_ENTITY){
+					QCVM_FAIL("statement %u needs 'time' and 'nextthink'", pc);
+				}
+				else if(QCVM_A->u32 >= ents->numEnts){
+					QCVM_FAIL("statement %u sets the think time of invalid entity %u", pc, QCVM_A->u32);
+				}
+
+				qcvm_storeField(ents, QCVM_A->u32, defs.nextthink, QC_VM_Slot{ .f32 = g[defs.time].f32 + QCVM_B->f32 });
+				break;
+			}
+
+			// If, Not
+
+			case QC_OP_NOT_F: QCVM_C->f32 = !QCVM_A->f32; break;
+			case QC_OP_NOT_V: QCVM_C->f32 = !QCVM_A[0].f32 && !QCVM_A[1].f32 && !QCVM_A[2].f32; break;
+			case QC_OP_NOT_S: QCVM_C->f32 = qcvm_slotString(vm, QCVM_A->u32).len == 0; break;
+
+			case QC_OP_NOT_ENT:
+			case QC_OP_NOT_FNC:
+				QCVM_C->f32 = QCVM_A->u32 == 0;
+				break;
+
+			// Function calls
+
+			case QC_OP_CALL8H: case QC_OP_CALL7H: case QC_OP_CALL6H:
+			case QC_OP_CALL5H: case QC_OP_CALL4H: case QC_OP_CALL3H:
+			case QC_OP_CALL2H:
+				g[QCVM_OFS_PARM0 + 3] = QCVM_C[0];
+				g[QCVM_OFS_PARM0 + 4] = QCVM_C[1];
+				g[QCVM_OFS_PARM0 + 5] = QCVM_C[2];
+				[[fallthrough]];
+
+			case QC_OP_CALL1H:
+				g[QCVM_OFS_PARM0] = QCVM_B[0];
+				g[QCVM_OFS_PARM0 + 1] = QCVM_B[1];
+				g[QCVM_OFS_PARM0 + 2] = QCVM_B[2];
+				[[fallthrough]];
+
+			case QC_OP_CALL0: case QC_OP_CALL1: case QC_OP_CALL2:
+			case QC_OP_CALL3: case QC_OP_CALL4: case QC_OP_CALL5:
+			case QC_OP_CALL6: case QC_OP_CALL7: case QC_OP_CALL8:{
+				const auto calleeIdx = QCVM_A->u32;
+
+				if(calleeIdx == 0 || calleeIdx >= vm->fnTable.size()){
+					QCVM_FAIL("called invalid function %u", calleeIdx);
+				}
+
+				const auto callee = &vm->fnTable[calleeIdx];
+
+				if(callee->fn.base.type != QC_VM_FN_BYTECODE){
+					if(!qcvm_callNative(vm, &callee->fn)){
+						QCVM_FAIL("error in native function called from statement %u", pc);
+					}
+
+					// natives may have loaded more bytecode
+					QCVM_CHECK_IMAGE(pc + 1);
+
+					g = vm->globalMem.data();
+					profiling = vm->profiling;
+					break;
+				}
+				else if(callee->entry == 0){
+					QCVM_FAIL("called undefined function %u", calleeIdx);
+				}
+				else if((callee->fn.base.flags & QC_FUNCTION_PURE) && vm->memoCapacity){
+					const auto nArgs = QC_MIN(callee->numArgs, 8u);
+
+					QC_Value args[8], res;
+					qcvm_parmArgs(vm, nArgs, args);
+
+					// runs nested so the result can be memoised
+					if(!qcvm_exec(vm, &callee->fn.base, calleeIdx, nArgs, args, &res)){
+						QCVM_FAIL("error in pure function called from statement %u", pc);
+					}
+
+					std::memcpy(vm->globalMem.data() + QCVM_OFS_RETURN, &res, 3 * sizeof(QC_VM_Slot));
+
+					QCVM_CHECK_IMAGE(pc + 1);
+
+					g = vm->globalMem.data();
+					profiling = vm->profiling;
+					break;
+				}
+				else if(!qcvm_ensureFn(vm, callee->entry)){
+					return false;
+				}
+				else if(!qcvm_enterFn(vm, calleeIdx, pc + 1)){
+					return false;
+				}
+
+				pc = callee->entry;
+				QCVM_CHECK_IMAGE(pc);
+				continue;
+			}
+
+			// Boolean operations
+
+			case QC_OP_AND: QCVM_C->f32 = QCVM_A->f32 && QCVM_B->f32; break;
+			case QC_OP_OR: QCVM_C->f32 = QCVM_A->f32 || QCVM_B->f32; break;
+			case QC_OP_BITAND: QCVM_C->f32 = QC_Float(QC_Int32(QCVM_A->f32) & QC_Int32(QCVM_B->f32)); break;
+			case QC_OP_BITOR: QCVM_C->f32 = QC_Float(QC_Int32(QCVM_A->f32) | QC_Int32(QCVM_B->f32)); break;
+
+			// Integer extensions
+
+			case QC_OP_ADD_I: QCVM_C->i32 = QCVM_A->i32 + QCVM_B->i32; break;
+			case QC_OP_SUB_I: QCVM_C->i32 = QCVM_A->i32 - QCVM_B->i32; break;
+			case QC_OP_MUL_I: QCVM_C->i32 = QCVM_A->i32 * QCVM_B->i32; break;
+
+			case QC_OP_DIV_I:{
+				if(QCVM_B->i32 == 0){
+					QCVM_FAIL("integer division by zero in statement %u", pc);
+				}
+
+				QCVM_C->i32 = QCVM_A->i32 / QCVM_B->i32;
+				break;
+			}
+
+			case QC_OP_BITAND_I: QCVM_C->i32 = QCVM_A->i32 & QCVM_B->i32; break;
+			case QC_OP_BITOR_I: QCVM_C->i32 = QCVM_A->i32 | QCVM_B->i32; break;
+			case QC_OP_BITXOR_I: QCVM_C->i32 = QCVM_A->i32 ^ QCVM_B->i32; break;
+			case QC_OP_LSHIFT_I: QCVM_C->i32 = QCVM_A->i32 << (QCVM_B->i32 & 31); break;
+			case QC_OP_RSHIFT_I: QCVM_C->i32 = QCVM_A->i32 >> (QCVM_B->i32 & 31); break;
+			case QC_OP_EQ_I: QCVM_C->i32 = QCVM_A->i32 == QCVM_B->i32; break;
+			case QC_OP_NE_I: QCVM_C->i32 = QCVM_A->i32 != QCVM_B->i32; break;
+			case QC_OP_LE_I: QCVM_C->i32 = QCVM_A->i32 <= QCVM_B->i32; break;
+			case QC_OP_GE_I: QCVM_C->i32 = QCVM_A->i32 >= QCVM_B->i32; break;
+			case QC_OP_LT_I: QCVM_C->i32 = QCVM_A->i32 < QCVM_B->i32; break;
+			case QC_OP_GT_I: QCVM_C->i32 = QCVM_A->i32 > QCVM_B->i32; break;
+			case QC_OP_NOT_I: QCVM_C->i32 = !QCVM_A->i32; break;
+			case QC_OP_CONV_ITOF: QCVM_C->f32 = QC_Float(QCVM_A->i32); break;
+			case QC_OP_CONV_FTOI: QCVM_C->i32 = QC_Int32(QCVM_A->f32); break;
+
+			default:{
+				QCVM_FAIL("unsupported op 0x%x in statement %u", st->op, pc);
+			}
+		}
+
+		++pc;
+	}
+
+#undef QCVM_CHECK_IMAGE
+#undef QCVM_BRANCH
+#undef QCVM_FAIL
+#undef QCVM_C
+#undef QCVM_B
+#undef QCVM_A
+}
+
+template<typename Stmt>
+static bool qcvm_interpretDialect(QC_VM *vm, QC_Uint32 pc, QC_Uint32 exitDepth, QC_Value *ret){
+	switch(vm->dialect){
+		case QCVM_DIALECT_VANILLA: return qcvm_interpret<QCVM_DIALECT_VANILLA, Stmt>(vm, pc, exitDepth, ret);
+		case QCVM_DIALECT_HEXEN2: return qcvm_interpret<QCVM_DIALECT_HEXEN2, Stmt>(vm, pc, exitDepth, ret);
+		case QCVM_DIALECT_FTE: return qcvm_interpret<QCVM_DIALECT_FTE, Stmt>(vm, pc, exitDepth, ret);
+		default: return qcvm_interpret<QCVM_DIALECT_FULL, Stmt>(vm, pc, exitDepth, ret);
+	}
+}
+
+extern "C" {
+
+static bool qcvm_run(QC_VM *vm, QC_Uint32 fnIdx, QC_Uint32 exitDepth, QC_Value *ret){
+	if(!qcvm_enterFn(vm, fnIdx, 0)){
+		return false;
+	}
+
+	const auto entry = vm->fnTable[fnIdx].entry;
+
+	if(vm->compactValid.load(std::memory_order_relaxed)){
+		return qcvm_interpretDialect<QC_ByteCodeStatement16>(vm, entry, exitDepth, ret);
+	}
+
+	return qcvm_interpretDialect<QC_ByteCodeStatement32>(vm, entry, exitDepth, ret);
+}
+
+bool qcvm_execLinked(QC_VM *vm, QC_Uint32 fnIdx, QC_Uint32 nArgs, const QC_Value *args, QC_Value *ret){
+	if(fnIdx == 0 || fnIdx >= vm->fnTable.size()){
+		qcLogError("invalid function index %u", fnIdx);
+		return false;
+	}
+
+	const auto fn = &vm->fnTable[fnIdx];
+
+	QC_VM_BuiltinReader builtinReader(vm);
+
+	for(QC_Uint32 i = 0; i < nArgs; i++){
+		const auto argSize = QC_MIN(QC_MAX(QC_Uint32(fn->argSizes[i]), 1u), 3u);
+		std::memcpy(vm->globalMem.data() + QCVM_OFS_PARM0 + (i * 3), args + i, argSize * sizeof(QC_VM_Slot));
+	}
+
+	if(fn->fn.base.type != QC_VM_FN_BYTECODE){
+		if(!qcvm_callNative(vm, &fn->fn)){
+			return false;
+		}
+
+		std::memcpy(ret, vm->globalMem.data() + QCVM_OFS_RETURN, 3 * sizeof(QC_VM_Slot));
+		return true;
+	}
+	else if(fn->entry == 0){
+		qcLogError("called undefined function %u", fnIdx);
+		return false;
+	}
+	else if(!qcvm_ensureFn(vm, fn->entry)){
+		return false;
+	}
+	else if(!vm->localStack.base && !qcvm_reserveStacks(vm)){
+		qcLogError("failed to reserve interpreter stacks");
+		return false;
+	}
+
+	const auto exitDepth = vm->frames.size();
+	const auto localDepth = vm->localStack.size();
+
+#ifdef QCVM_STACK_GUARD_PAGES
+	QC_VM_StackGuard guard;
+	guard.vm = vm;
+	guard.prev = qcvm_activeStackGuard;
+	qcvm_activeStackGuard = &guard;
+
+	// an overflow faults in a guard page and lands back here
+	if(sigsetjmp(guard.jmp, 0)){
+		qcvm_activeStackGuard = guard.prev;
+		qcLogError("stack overflow in function %u", fnIdx);
+		qcvm_unwind(vm, exitDepth, localDepth);
+		return false;
+	}
+
+	const auto res = qcvm_run(vm, fnIdx, exitDepth, ret);
+	qcvm_activeStackGuard = guard.prev;
+#else
+	const auto res = qcvm_run(vm, fnIdx, exitDepth, ret);
+#endif
+
+	if(!res){
+		qcvm_unwind(vm, exitDepth, localDepth);
+	}
+
+	return res;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef QCVM_FASTMATH_HPP
+#define QCVM_FASTMATH_HPP 1
+
+#include "qcvm/common.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define QCVM_FASTMATH_SSE 1
+#endif
+
+/**
+ * Approximations used by VMs created with `QC_VM_CREATE_FAST_MATH`.
+ * Results may differ from IEEE results in the last few bits and are undefined for zero, infinite and NaN inputs.
+ */
+namespace qcvm{
+	inline QC_Float fastRcp(QC_Float x) noexcept{
+#ifdef QCVM_FASTMATH_SSE
+		const auto v = _mm_set_ss(x);
+		const auto r = _mm_rcp_ss(v);
+		// one newton-raphson step takes the 12 bit estimate to ~22 bits
+		return _mm_cvtss_f32(_mm_mul_ss(r, _mm_sub_ss(_mm_set_ss(2.f), _mm_mul_ss(v, r))));
+#else
+		return 1.f / x;
+#endif
+	}
+
+	inline QC_Float fastRsqrt(QC_Float x) noexcept{
+#ifdef QCVM_FASTMATH_SSE
+		const auto r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+		return r * (1.5f - (0.5f * x * r * r));
+#else
+		return 1.f / std::sqrt(x);
+#endif
+	}
+
+	inline QC_Float fastDot3(QC_Float ax, QC_Float ay, QC_Float az, QC_Float bx, QC_Float by, QC_Float bz) noexcept{
+#ifdef FP_FAST_FMAF
+		return std::fma(ax, bx, std::fma(ay, by, az * bz));
+#else
+		return (ax * bx) + (ay * by) + (az * bz);
+#endif
+	}
+}
+
+#endif // !QCVM_FASTMATH_HPP
@@ -0,0 +1,227 @@
+#ifndef QCVM_SYMTAB_HPP
+#define QCVM_SYMTAB_HPP 1
+
+#include "qcvm/hash.hpp"
+
+#include "parallel_hashmap/phmap.h"
+
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qcvm{
+	inline Uint64 mix64(Uint64 x) noexcept{
+		x ^= x >> 30u;
+		x *= 0xbf58476d1ce4e5b9ull;
+		x ^= x >> 27u;
+		x *= 0x94d049bb133111ebull;
+		x ^= x >> 31u;
+		return x;
+	}
+
+	// maps a hash uniformly onto [0, n)
+	inline Uint32 fastRange(Uint64 h, Uint32 n) noexcept{
+		return Uint32((Uint64(Uint32(h >> 32u)) * n) >> 32u);
+	}
+}
+
+/**
+ * Name to value table compiled into a perfect hash.
+ *
+ * Keys are views, usually into bytecode string tables, and values live in a dense array with stable addresses.
+ * Symbols added since the last \ref build are kept in a small side table until the next build, as are keys whose
+ * 64-bit hashes are equal since no pilot can tell them apart.
+ */
+template<typename T>
+struct QC_VM_SymbolTable{
+	std::vector<std::string_view> keys;
+	std::deque<T> values;
+
+	// perfect hash over keys[0, numBuilt) except those left in `pending`, empty if it could not be built
+	QC_Uint32 numBuilt = 0;
+	QC_Uint64 seed = 0;
+	std::vector<QC_Uint16> pilots; // one per bucket
+	std::vector<QC_Uint32> slots; // symbol index or UINT32_MAX
+
+	phmap::flat_hash_map<std::string_view, QC_Uint32> pending;
+	std::deque<std::string> ownedKeys; // keys that don't point into bytecode
+
+	QC_Uint32 size() const noexcept{ return QC_Uint32(keys.size()); }
+
+	QC_Uint32 findIndex(std::string_view key) const noexcept{
+		if(!pilots.empty()){
+			const auto h = qcvm::Fnv1aHash::hash64(key);
+			const auto bucket = qcvm::fastRange(qcvm::mix64(h ^ seed), QC_Uint32(pilots.size()));
+			const auto idx = slots[slotOf(h, pilots[bucket])];
+
+			if(idx != UINT32_MAX && keys[idx] == key){
+				return idx;
+			}
+		}
+
+		if(!pending.empty()){
+			const auto res = pending.find(key);
+			if(res != pending.end()) return res->second;
+		}
+
+		return UINT32_MAX;
+	}
+
+	T *find(std::string_view key) noexcept{
+		const auto idx = findIndex(key);
+		return idx == UINT32_MAX ? nullptr : &values[idx];
+	}
+
+	const T *find(std::string_view key) const noexcept{
+		const auto idx = findIndex(key);
+		return idx == UINT32_MAX ? nullptr : &values[idx];
+	}
+
+	/**
+	 * Find a symbol or add a default constructed one.
+	 * @param copyKey Copy the key instead of referring to it, for names that don't outlive the VM
+	 */
+	std::pair<T*, bool> tryEmplace(std::string_view key, bool copyKey = false){
+		const auto idx = findIndex(key);
+		if(idx != UINT32_MAX){
+			return { &values[idx], false };
+		}
+
+		if(copyKey){
+			key = ownedKeys.emplace_back(key);
+		}
+
+		const auto newIdx = QC_Uint32(keys.size());
+		keys.emplace_back(key);
+		values.emplace_back();
+		pending.emplace(key, newIdx);
+		return { &values.back(), true };
+	}
+
+	//! Compile every symbol into the perfect hash
+	void build(){
+		const auto n = QC_Uint32(keys.size());
+		if(n == numBuilt) return;
+
+		std::vector<QC_Uint64> hashes(n);
+		std::vector<QC_Uint32> byHash(n);
+
+		for(QC_Uint32 i = 0; i < n; i++){
+			hashes[i] = qcvm::Fnv1aHash::hash64(keys[i]);
+			byHash[i] = i;
+		}
+
+		std::sort(byHash.begin(), byHash.end(), [&](QC_Uint32 a, QC_Uint32 b){ return hashes[a] < hashes[b]; });
+
+		pending.clear();
+
+		std::vector<QC_Uint32> members;
+		members.reserve(n);
+
+		for(QC_Uint32 i = 0; i < n;){
+			auto end = i + 1;
+			while(end < n && hashes[byHash[end]] == hashes[byHash[i]]) end++;
+
+			for(auto j = i; j < end; j++){
+				if(end - i == 1) members.emplace_back(byHash[j]);
+				else pending.emplace(keys[byHash[j]], byHash[j]);
+			}
+
+			i = end;
+		}
+
+		// ~4 keys per bucket, slots at a load factor of ~0.9
+		const auto m = QC_Uint32(members.size());
+		auto numBuckets = (m / 4u) + 1u;
+		const auto numSlots = m + (m / 8u) + 1u;
+
+		bool built = false;
+
+		for(QC_Uint64 attempt = 0; attempt < maxBuildAttempts && !built; attempt++){
+			built = tryBuild(hashes, members, attempt, numBuckets, numSlots);
+			numBuckets += (numBuckets / 4u) + 1u;
+		}
+
+		if(!built){
+			// distinct hashes always place eventually, this only guards against a pathological seed sequence
+			pilots.clear();
+			slots.clear();
+
+			for(const auto i : members){
+				pending.emplace(keys[i], i);
+			}
+		}
+
+		numBuilt = n;
+	}
+
+	private:
+		QC_Uint32 slotOf(QC_Uint64 h, QC_Uint16 pilot) const noexcept{
+			return qcvm::fastRange(qcvm::mix64(h ^ (QC_Uint64(pilot) * 0x9e3779b97f4a7c15ull)), QC_Uint32(slots.size()));
+		}
+
+		static constexpr QC_Uint64 maxBuildAttempts = 64;
+
+		bool tryBuild(
+			const std::vector<QC_Uint64> &hashes, const std::vector<QC_Uint32> &members,
+			QC_Uint64 attemptSeed, QC_Uint32 numBuckets, QC_Uint32 numSlots
+		){
+			seed = qcvm::mix64(attemptSeed + 1u);
+			pilots.assign(numBuckets, 0);
+			slots.assign(numSlots, UINT32_MAX);
+
+			std::vector<std::vector<QC_Uint32>> buckets(numBuckets);
+			for(const auto i : members){
+				buckets[qcvm::fastRange(qcvm::mix64(hashes[i] ^ seed), numBuckets)].emplace_back(i);
+			}
+
+			// place the largest buckets while there is the most room
+			std::vector<QC_Uint32> order(numBuckets);
+			std::iota(order.begin(), order.end(), 0u);
+			std::stable_sort(order.begin(), order.end(), [&](QC_Uint32 a, QC_Uint32 b){
+				return buckets[a].size() > buckets[b].size();
+			});
+
+			std::vector<QC_Uint32> positions;
+
+			for(const auto b : order){
+				const auto &bucket = buckets[b];
+				if(bucket.empty()) break;
+
+				bool placed = false;
+
+				for(QC_Uint32 pilot = 0; pilot <= UINT16_MAX && !placed; pilot++){
+					positions.clear();
+
+					for(const auto i : bucket){
+						const auto pos = slotOf(hashes[i], QC_Uint16(pilot));
+						if(slots[pos] != UINT32_MAX || std::find(positions.begin(), positions.end(), pos) != positions.end()){
+							break;
+						}
+
+						positions.emplace_back(pos);
+					}
+
+					if(positions.size() != bucket.size()){
+						continue;
+					}
+
+					for(std::size_t j = 0; j < bucket.size(); j++){
+						slots[positions[j]] = bucket[j];
+					}
+
+					pilots[b] = QC_Uint16(pilot);
+					placed = true;
+				}
+
+				if(!placed) return false;
+			}
+
+			return true;
+		}
+};
+
+#endif // !QCVM_SYMTAB_HPP
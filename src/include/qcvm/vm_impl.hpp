@@ -0,0 +1,680 @@
+#ifndef QCVM_VM_IMPL_HPP
+#define QCVM_VM_IMPL_HPP 1
+
+#include "qcvm/vm.h"
+#include "qcvm/string.h"
+
+#include "parallel_hashmap/phmap_fwd_decl.h"
+#include "parallel_hashmap/phmap.h"
+#include "parallel_hashmap/btree.h"
+
+#include "qcvm/hash.hpp"
+#include "qcvm/symtab.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+template<
+	class Key, class Value,
+	class Hash  = phmap::priv::hash_default_hash<Key>,
+	class Eq    = phmap::priv::hash_default_eq<Key>,
+	class Alloc = phmap::priv::Allocator<phmap::priv::Pair<const Key, Value>>
+>
+using NodeHashMap = phmap::node_hash_map<Key, Value, Hash, Eq, Alloc>;
+
+template<
+	class Key, class Value,
+	class Hash  = phmap::priv::hash_default_hash<Key>,
+	class Eq    = phmap::priv::hash_default_eq<Key>,
+	class Alloc = phmap::priv::Allocator<phmap::priv::Pair<const Key, Value>>
+>
+using FlatHashMap = phmap::flat_hash_map<Key, Value, Hash, Eq, Alloc>;
+
+template<
+    class Key, class Value,
+	class Compare = phmap::Less<Key>,
+	class Alloc   = phmap::Allocator<phmap::priv::Pair<const Key, Value>>
+>
+using FlatMap = phmap::btree_map<Key, Value, Compare, Alloc>;
+
+#ifdef __linux__
+// stack overflow is caught by a guard region instead of bounds checks
+#define QCVM_STACK_GUARD_PAGES 1
+#include <csetjmp>
+#endif
+
+// must be at least the size of the largest single push
+#define QCVM_STACK_GUARD_BYTES (64u * 1024u)
+
+void *qcvm_mapStack(size_t bytes);
+void qcvm_unmapStack(void *mem, size_t bytes);
+
+/**
+ * Fixed capacity stack in its own mapping.
+ * Memory is only committed as it is touched and pushing past the end faults in the guard region.
+ */
+template<typename T>
+struct QC_VM_Stack{
+	T *base = nullptr, *top = nullptr, *limit = nullptr;
+	void *mem = nullptr;
+	size_t memSize = 0;
+
+	QC_VM_Stack() = default;
+	QC_VM_Stack(const QC_VM_Stack&) = delete;
+
+	~QC_VM_Stack(){
+		if(mem) qcvm_unmapStack(mem, memSize);
+	}
+
+	QC_VM_Stack &operator=(const QC_VM_Stack&) = delete;
+
+	bool reserve(size_t capacity){
+		const auto pageSize = qcPageSize();
+		const auto bytes = capacity * sizeof(T);
+
+		memSize = ((bytes + pageSize - 1) / pageSize) * pageSize;
+		mem = qcvm_mapStack(memSize);
+		if(!mem) return false;
+
+		// align the end of the stack with the guard
+		limit = reinterpret_cast<T*>(static_cast<char*>(mem) + memSize);
+		base = top = limit - capacity;
+		return true;
+	}
+
+	bool isGuard(const void *addr) const noexcept{
+		const auto p = static_cast<const char*>(addr);
+		const auto guardBegin = reinterpret_cast<const char*>(limit);
+		return p >= guardBegin && p < (guardBegin + QCVM_STACK_GUARD_BYTES);
+	}
+
+	QC_Uint32 size() const noexcept{ return QC_Uint32(top - base); }
+	T *data() noexcept{ return base; }
+	T &back() noexcept{ return top[-1]; }
+
+	bool push(const T &val) noexcept{
+#ifndef QCVM_STACK_GUARD_PAGES
+		if(top == limit) return false;
+#endif
+		*top = val;
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		++top;
+		return true;
+	}
+
+	bool push(const T *vals, QC_Uint32 n) noexcept{
+#ifndef QCVM_STACK_GUARD_PAGES
+		if(QC_Uint32(limit - top) < n) return false;
+#endif
+		std::memcpy(top, vals, n * sizeof(T));
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		top += n;
+		return true;
+	}
+
+	void pop() noexcept{ --top; }
+	void truncate(QC_Uint32 n) noexcept{ top = base + n; }
+};
+
+extern "C" {
+
+// null, return value and 8 vector parameters
+#define QCVM_OFS_NULL 0u
+#define QCVM_OFS_RETURN 1u
+#define QCVM_OFS_PARM0 4u
+#define QCVM_NUM_RESERVED_GLOBALS 28u
+
+// zeroed slots after the last global, RETURN and the CALLnH arguments copy 3 slots whatever the type
+#define QCVM_GLOBAL_PADDING 2u
+
+#define QCVM_DEF_SAVEGLOBAL (1u << 15u)
+
+union QC_VM_FnStorage{
+	QC_VM_Fn base;
+	QC_VM_Fn_Bytecode bytecode;
+	QC_VM_Fn_Native native;
+	QC_VM_Fn_Builtin builtin;
+};
+
+union QC_VM_Slot{
+	QC_Uint32 u32;
+	QC_Int32 i32;
+	QC_Float f32;
+};
+
+static_assert(sizeof(QC_VM_Slot) == 4, "misaligned QC_VM_Slot");
+
+// address space reserved for entity fields, only touched pages are committed
+#define QCVM_ENTITY_ARENA_BYTES (64u << 20u)
+
+// entities per column in the structure-of-arrays layout
+#define QCVM_ENTITY_COLUMN_SHIFT 13u
+#define QCVM_ENTITY_COLUMN_SIZE (1u << QCVM_ENTITY_COLUMN_SHIFT)
+
+struct QC_VM_EntityInfo{
+	QC_Uint32 gen; // bumped on every remove, so handles from before it stop matching
+	QC_Uint32 nextFree; // towards the back of the free queue
+	QC_Float freeTime;
+	bool live;
+};
+
+#define QCVM_NO_ENTITY UINT32_MAX
+
+// what has to happen when bytecode or the host writes a field, by linked field offset
+enum QC_VM_FieldWatch: QC_Uint8{
+	QCVM_WATCH_SPATIAL = 0x1,
+	QCVM_WATCH_FIND = 0x2,
+	QCVM_WATCH_CHANGES = 0x4,
+	QCVM_WATCH_THINK = 0x8,
+};
+
+struct QC_VM_EntityStore;
+
+/**
+ * Hash grid over the bounding box center of every live entity, `origin` if there are no `mins` and `maxs` fields.
+ * Writes only mark the entity, it is moved between cells the next time the grid is queried.
+ */
+struct QC_VM_SpatialIndex{
+	struct Entry{
+		QC_Uint64 cell;
+		QC_Uint32 pos; // in the cell
+		bool indexed, dirty;
+	};
+
+	QC_Uint32 field = QCVM_NO_ENTITY; // `origin`, none while disabled
+	QC_Uint32 mins = QCVM_NO_ENTITY, maxs = QCVM_NO_ENTITY;
+	QC_Float cellSize = 0.f;
+	FlatHashMap<QC_Uint64, std::vector<QC_Uint32>> cells;
+	std::vector<Entry> entries; // by entity
+	std::vector<QC_Uint32> dirty;
+
+	void markDirty(QC_Uint32 ent);
+	void flush(const QC_VM_EntityStore &ents);
+
+	//! Append every live entity within \p rad of \p org to \p ret, in no particular order
+	void query(const QC_VM_EntityStore &ents, QC_Vector org, QC_Float rad, std::vector<QC_Uint32> &ret);
+};
+
+/**
+ * Live entities by the contents of a string field, for `find`.
+ * Updated lazily like QC_VM_SpatialIndex, the empty string is a key like any other as `find` matches it too.
+ */
+struct QC_VM_FindIndex{
+	struct Entry{
+		QC_Uint32 key; // into members, only valid while indexed
+		bool indexed, dirty;
+	};
+
+	QC_Uint32 field;
+	FlatHashMap<std::string, QC_Uint32> keys; // each distinct field value once, copied when first seen
+	std::vector<std::vector<QC_Uint32>> members; // by key, each sorted by entity index
+	std::vector<Entry> entries; // by entity
+	std::vector<QC_Uint32> dirty;
+
+	void markDirty(QC_Uint32 ent);
+	void flush(const QC_VM_EntityStore &ents, const QC_StringBuffer *strBuf);
+
+	//! Key for the field value \p str, added if it was never seen before
+	QC_Uint32 intern(std::string_view str);
+
+	//! First indexed entity after \p start whose field is \p match, `0` if there is none
+	QC_Uint32 next(QC_Uint32 start, std::string_view match) const;
+};
+
+/**
+ * Which entity fields were written in which change sequence, for sending deltas.
+ * Only entities with changes are listed, so walking them costs nothing for untouched entities.
+ */
+struct QC_VM_ChangeLog{
+	struct Entry{
+		QC_Uint32 seq; // latest change to any field
+		bool listed;
+		std::vector<QC_Uint64> bits; // changed fields
+		std::vector<QC_Uint32> fieldSeq; // latest change by field
+	};
+
+	bool enabled = false;
+	QC_Uint32 seq = 1;
+	std::vector<Entry> entries; // by entity
+	std::vector<QC_Uint32> changed; // entities with any bits set
+
+	void mark(QC_Uint32 ent, QC_Uint32 field);
+	void markAll(QC_Uint32 ent, QC_Uint32 numFields);
+
+	//! Forget changes made before \p beforeSeq
+	void clear(QC_Uint32 beforeSeq);
+};
+
+/**
+ * Entities with a pending `nextthink`, earliest first and by index between equal times.
+ * Writes only mark the entity, heap items left behind by a changed `nextthink` are skipped when popped.
+ */
+struct QC_VM_ThinkQueue{
+	struct Item{
+		QC_Float time;
+		QC_Uint32 ent;
+
+		bool operator>(const Item &other) const noexcept{
+			return time > other.time || (time == other.time && ent > other.ent);
+		}
+	};
+
+	struct Entry{
+		QC_Float time;
+		bool queued, dirty;
+	};
+
+	QC_Uint32 field = QCVM_NO_ENTITY; // none until thinks are first run
+	std::vector<Item> heap;
+	std::vector<Entry> entries; // by entity
+	std::vector<QC_Uint32> dirty;
+
+	void markDirty(QC_Uint32 ent);
+	void flush(const QC_VM_EntityStore &ents);
+
+	//! Take the next entity due by \p time, after flushing
+	bool pop(QC_Float time, QC_Uint32 *entRet, QC_Float *timeRet);
+};
+
+/**
+ * Entity fields in one arena, addressed by linked field offset.
+ *
+ * By default every entity is a block of `stride` slots. With `soa` every field slot is a column of
+ * QCVM_ENTITY_COLUMN_SIZE entities instead, so host passes over one field touch only that field.
+ * Either way the field at `offset` of `ent` is `base[(ent * entStep) + (offset * fieldStep)]`, and the arena
+ * is mapped once so nothing moves while the host holds pointers from qcVMFieldData. Bytecode only holds tagged
+ * pointers from fieldPtr.
+ */
+struct QC_VM_EntityStore{
+	QC_VM_Slot *base = nullptr;
+	void *mem = nullptr;
+	size_t memSize = 0;
+
+	bool soa = false; // QC_VM_CREATE_ENTITY_SOA
+	QC_Uint32 stride = 0; // slots per entity
+	QC_Uint32 entStep = 0, fieldStep = 1;
+
+	QC_Uint32 numEnts = 0; // every entity below this has fields, live or not
+	std::vector<QC_VM_EntityInfo> info;
+	std::vector<QC_Uint64> liveBits; // a bit per live entity except the world, for skipping free ones a word at a time
+	mutable std::vector<QC_Uint32> liveList; // qcVMLiveEntities, rebuilt from liveBits when stale
+	mutable bool liveListStale = false;
+
+	// removed entities queue up oldest first and are reused once they have been free for reuseDelay
+	QC_Uint32 freeHead = QCVM_NO_ENTITY, freeTail = QCVM_NO_ENTITY;
+	QC_Float reuseDelay = 0.f;
+
+	// QC_OP_ADDRESS pointers are `field << ptrShift | ent` whatever the layout, set by setStride
+	QC_Uint32 ptrShift = 29;
+	bool ptrsTaken = false; // set by the first QC_OP_ADDRESS, from then on bytecode may hold pointers in any global
+
+	std::vector<QC_Uint8> fieldWatch; // QC_VM_FieldWatch by linked field offset, for every field a pointer can name
+	QC_VM_SpatialIndex spatial;
+
+	std::vector<QC_VM_FindIndex> findIndices;
+	FlatHashMap<QC_Uint32, QC_Uint32> findScans; // unindexed `find` calls by field
+	QC_Uint32 findAutoIndex = 0; // scans before a field is indexed, 0 never
+
+	QC_VM_ChangeLog changes;
+	QC_VM_ThinkQueue thinks;
+
+	QC_VM_EntityStore() = default;
+	QC_VM_EntityStore(const QC_VM_EntityStore&) = delete;
+
+	~QC_VM_EntityStore();
+
+	QC_VM_EntityStore &operator=(const QC_VM_EntityStore&) = delete;
+
+	//! Map the arena and create the world
+	bool reserve();
+
+	//! Grow every entity to \p newStride slots, keeping entity indices
+	bool setStride(QC_Uint32 newStride);
+
+	/**
+	 * Index of a new entity with zeroed fields, `0` if the arena is full.
+	 * @param now Time to measure the reuse delay against
+	 */
+	QC_Uint32 spawn(QC_Float now);
+	void remove(QC_Uint32 ent, QC_Float now);
+
+	//! Called before \p field of \p ent is written, if the field is watched
+	void touch(QC_Uint32 ent, QC_Uint32 field);
+
+	//! Mark \p ent in every index after it was spawned or removed
+	void touchAll(QC_Uint32 ent);
+
+	QC_VM_FindIndex *findIndex(QC_Uint32 field) noexcept{
+		for(auto &index : findIndices){
+			if(index.field == field) return &index;
+		}
+
+		return nullptr;
+	}
+
+	QC_Uint32 capacity() const noexcept{
+		return soa ? QCVM_ENTITY_COLUMN_SIZE : QC_Uint32(memSize / (QC_MAX(stride, 1u) * sizeof(QC_VM_Slot)));
+	}
+
+	bool isLive(QC_Uint32 ent) const noexcept{ return ent < numEnts && info[ent].live; }
+
+	//! First live entity after \p ent, `0` if there is none
+	QC_Uint32 nextLive(QC_Uint32 ent) const noexcept{
+		std::size_t word = (std::size_t(ent) + 1) / 64u;
+		if(word >= liveBits.size()){
+			return 0;
+		}
+
+		auto bits = liveBits[word] & (~QC_Uint64(0) << ((ent + 1) % 64u));
+
+		while(!bits){
+			if(++word == liveBits.size()) return 0;
+			bits = liveBits[word];
+		}
+
+		return QC_Uint32((word * 64u) + std::countr_zero(bits));
+	}
+
+	QC_Entity handle(QC_Uint32 ent) const noexcept{
+		return QC_Entity(ent) | (QC_Entity(info[ent].gen) << QC_ENTITY_INDEX_BITS);
+	}
+
+	//! Removing an entity changes its handle, so a live handle is one that still matches
+	bool isValid(QC_Entity h) const noexcept{
+		const auto ent = qcEntityIndex(h);
+		return ent < numEnts && h == handle(ent);
+	}
+
+	QC_Uint32 address(QC_Uint32 ent, QC_Uint32 field) const noexcept{ return (ent * entStep) + (field * fieldStep); }
+
+	QC_Uint32 fieldPtr(QC_Uint32 ent, QC_Uint32 field) const noexcept{ return (field << ptrShift) | ent; }
+	QC_Uint32 ptrEntity(QC_Uint32 ptr) const noexcept{ return ptr & ((1u << ptrShift) - 1u); }
+	QC_Uint32 ptrField(QC_Uint32 ptr) const noexcept{ return ptr >> ptrShift; }
+
+	//! Whether \p n slots of one field starting at \p ptr all belong to an entity, global pointers never do
+	bool validPtr(QC_Uint32 ptr, QC_Uint32 n) const noexcept{
+		const auto ent = ptrEntity(ptr), field = ptrField(ptr);
+		return ent < numEnts && field < stride && (stride - field) >= n;
+	}
+
+	QC_VM_Slot &slot(QC_Uint32 ent, QC_Uint32 field) noexcept{ return base[address(ent, field)]; }
+	const QC_VM_Slot &slot(QC_Uint32 ent, QC_Uint32 field) const noexcept{ return base[address(ent, field)]; }
+};
+
+struct QC_VM_Global{
+	QC_Uint32 type;
+	QC_Uint32 slot; // index into QC_VM::globalMem
+};
+
+struct QC_VM_Module{
+	const QC_ByteCode *bc;
+	QC_Uint32 stmtBase, stmtEnd;
+	QC_Uint32 fnBase;
+	std::vector<QC_Uint32> globalMap; // module global index -> QC_VM::globalMem index
+	std::vector<QC_Uint32> fieldMap; // module field offset -> QC_VM::ents field offset
+	std::vector<QC_Uint32> entries; // sorted function entry statements in QC_VM::code
+	bool inferPure = false; // loaded with QC_VM_LOAD_INFER_PURE, re-inferred whenever another module is loaded
+};
+
+// state of the function body starting at a statement
+enum QC_VM_CodeState: QC_Uint8{
+	QCVM_CODE_PENDING = 0, // not validated or decoded yet
+	QCVM_CODE_BUSY,
+	QCVM_CODE_READY,
+	QCVM_CODE_INVALID,
+};
+
+// opcode sets the interpreter is instantiated for, each one includes the sets before it
+enum QC_VM_Dialect: QC_Uint8{
+	QCVM_DIALECT_VANILLA = 0,
+	QCVM_DIALECT_HEXEN2, // up to QC_OP_NE_FI
+	QCVM_DIALECT_FTE, // up to QC_OP_LOADP_B
+	QCVM_DIALECT_FULL, // 64-bit and double extensions
+};
+
+static constexpr QC_Uint32 qcvm_dialectMaxOp(QC_VM_Dialect dialect){
+	switch(dialect){
+		case QCVM_DIALECT_VANILLA: return QC_OP_BITOR;
+		case QCVM_DIALECT_HEXEN2: return QC_OP_NE_FI;
+		case QCVM_DIALECT_FTE: return QC_OP_LOADP_B;
+		default: return UINT32_MAX;
+	}
+}
+
+static constexpr QC_VM_Dialect qcvm_opDialect(QC_Uint32 op){
+	if(op <= qcvm_dialectMaxOp(QCVM_DIALECT_VANILLA)) return QCVM_DIALECT_VANILLA;
+	else if(op <= qcvm_dialectMaxOp(QCVM_DIALECT_HEXEN2)) return QCVM_DIALECT_HEXEN2;
+	else if(op <= qcvm_dialectMaxOp(QCVM_DIALECT_FTE)) return QCVM_DIALECT_FTE;
+	else return QCVM_DIALECT_FULL;
+}
+
+/**
+ * Entry of the call descriptor table, indexed by linked function index.
+ * Bytecode functions have a non-zero `entry` into QC_VM::code.
+ */
+struct QC_VM_LinkedFn{
+	QC_VM_FnStorage fn;
+	QC_Uint32 entry;
+	QC_Uint32 localIdx;
+	QC_Uint32 numLocals;
+	QC_Uint32 numArgs;
+	QC_Int8 argSizes[8];
+	bool inferredPure; // QC_FUNCTION_PURE came from QC_VM_LOAD_INFER_PURE, not the host
+};
+
+struct QC_VM_FnHandleEntry{
+	std::string name;
+	QC_VM_FnStorage fn;
+	QC_Uint32 fnIdx; // linked index of bytecode functions
+	bool found;
+};
+
+#define QCVM_MAX_BUILTINS (1u << 16u)
+
+// immutable once published, replaced wholesale whenever a builtin changes
+struct QC_VM_BuiltinTable{
+	std::vector<QC_VM_Fn_Builtin> fns; // by builtin index, null ptr if unset
+};
+
+struct QC_VM_RetiredBuiltins{
+	const QC_VM_BuiltinTable *table;
+	QC_Uint64 epoch; // epoch the table was replaced in
+};
+
+struct QC_VM_Frame{
+	QC_Uint32 stmt;
+	QC_Uint32 fnIdx;
+	QC_Uint32 localBase; // saved locals in QC_VM::localStack
+};
+
+#ifdef QCVM_STACK_GUARD_PAGES
+struct QC_VM_StackGuard{
+	QC_VM *vm;
+	QC_VM_StackGuard *prev;
+	sigjmp_buf jmp;
+};
+
+extern thread_local QC_VM_StackGuard *qcvm_activeStackGuard;
+
+bool qcvm_installStackGuard();
+#endif
+
+// function compiled for lockstep execution, operands refer to wide slots
+struct QC_VM_WideFn{
+	bool supported;
+	QC_Uint32 entry;
+	QC_Uint32 localBase; // wide slot of the first local
+	std::vector<QC_ByteCodeStatement> code;
+	std::vector<QC_Uint32> slots; // wide slot -> QC_VM::globalMem index
+};
+
+struct QC_VM_MemoKey{
+	const void *ids[2];
+	QC_Uint32 nSlots;
+	QC_Uint32 slots[24];
+
+	bool operator==(const QC_VM_MemoKey &other) const noexcept{
+		return ids[0] == other.ids[0] && ids[1] == other.ids[1] && nSlots == other.nSlots
+			&& std::memcmp(slots, other.slots, nSlots * sizeof(QC_Uint32)) == 0;
+	}
+};
+
+struct QC_VM_MemoKeyHash{
+	size_t operator()(const QC_VM_MemoKey &key) const noexcept{
+		const auto idHash = qcvm::PointerHash::hash64(key.ids[0]) ^ qcvm::PointerHash::hash64(key.ids[1]);
+		const auto slotBytes = std::string_view(reinterpret_cast<const char*>(key.slots), key.nSlots * sizeof(QC_Uint32));
+		return size_t(idHash ^ qcvm::Fnv1aHash::hash64(slotBytes));
+	}
+};
+
+struct QC_VM{
+	const QC_Allocator *allocator;
+	QC_DefaultBuiltins vmBuiltins;
+	QC_StringBuffer *strBuf;
+
+	// read without locking by the executing thread, writers serialize on builtinMut
+	std::atomic<const QC_VM_BuiltinTable*> builtinTable = nullptr;
+	std::atomic<QC_Uint64> builtinEpoch = 1;
+	std::atomic<QC_Uint64> builtinReaderEpoch = 0; // pinned by the executing thread, 0 if quiescent
+	QC_Uint32 builtinReadDepth = 0;
+	std::mutex builtinMut;
+	std::vector<QC_VM_RetiredBuiltins> retiredBuiltins;
+
+	bool fastMath = false; // QC_VM_CREATE_FAST_MATH
+	bool checkPointers = true; // cleared by QC_VM_CREATE_UNCHECKED_POINTERS
+
+	// rebuilt after every load, names refer to bytecode strings
+	QC_VM_SymbolTable<QC_VM_Global> globals;
+	QC_VM_SymbolTable<QC_VM_FnStorage> fns;
+	QC_VM_SymbolTable<QC_VM_Global> fields; // slot is the linked field offset
+
+	QC_VM_EntityStore ents;
+
+	// used by QC_OP_STATE, QC_OP_THINKTIME and qcVMRunThinks, QCVM_NO_ENTITY while not loaded
+	struct{
+		QC_Uint32 self, other, time; // globals
+		QC_Uint32 frame, think, nextthink; // fields
+	} thinkDefs = { QCVM_NO_ENTITY, QCVM_NO_ENTITY, QCVM_NO_ENTITY, QCVM_NO_ENTITY, QCVM_NO_ENTITY, QCVM_NO_ENTITY };
+
+
+	// linked image of every loaded module
+	std::vector<QC_VM_Module> modules;
+	std::vector<QC_ByteCodeStatement> code;
+	std::vector<QC_Uint8> codeState; // QC_VM_CodeState, indexed by entry statement
+
+	// decoded statements in 8 bytes each, run instead of code until a statement doesn't fit
+	std::vector<QC_ByteCodeStatement16> compactCode;
+	std::atomic<bool> compactValid = true;
+	std::vector<QC_VM_Slot> globalMem;
+	std::vector<QC_VM_LinkedFn> fnTable;
+	QC_VM_Dialect dialect = QCVM_DIALECT_VANILLA; // smallest dialect covering every linked statement
+
+	// recorded by the interpreter while profiling, by linked statement and global slot
+	bool profiling = false;
+	std::vector<QC_VM_StmtProfile> stmtProfile;
+	std::vector<QC_Uint64> globalProfile;
+
+	// interpreter stacks, reserved on first execution
+	QC_VM_Stack<QC_VM_Frame> frames;
+	QC_VM_Stack<QC_VM_Slot> localStack;
+
+	// resolved once by name, indexed by handle
+	std::vector<QC_VM_Global> globalHandles;
+	std::vector<QC_VM_FnHandleEntry> fnHandles;
+
+	FlatHashMap<QC_Uint32, QC_VM_WideFn> wideFns;
+
+	QC_Uintptr memoCapacity = 0;
+	FlatHashMap<QC_VM_MemoKey, QC_Value, QC_VM_MemoKeyHash> memo;
+	std::atomic<bool> memoStale = false; // set when builtins are swapped from another thread
+};
+
+//! Pins the current builtin table for the lifetime of the reader, nests freely on the executing thread
+struct QC_VM_BuiltinReader{
+	QC_VM *vm;
+
+	explicit QC_VM_BuiltinReader(QC_VM *vm_) noexcept: vm(vm_){
+		if(vm->builtinReadDepth++ == 0){
+			vm->builtinReaderEpoch.store(vm->builtinEpoch.load());
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+	}
+
+	~QC_VM_BuiltinReader(){
+		if(--vm->builtinReadDepth == 0){
+			vm->builtinReaderEpoch.store(0, std::memory_order_release);
+		}
+	}
+};
+
+//! Whether any thread is inside \p vm, for calls that may only be made on a stopped VM
+static inline bool qcvm_isRunning(const QC_VM *vm){
+	return vm->builtinReaderEpoch.load(std::memory_order_acquire) != 0;
+}
+
+//! Number of slots in QC_VM::globalMem, not counting the padding
+static inline QC_Uint32 qcvm_numGlobals(const QC_VM *vm){
+	return QC_Uint32(vm->globalMem.size()) - QCVM_GLOBAL_PADDING;
+}
+
+//! Current definition of builtin \p index, only valid while a \ref QC_VM_BuiltinReader is alive
+static inline const QC_VM_Fn_Builtin *qcvm_findBuiltin(const QC_VM *vm, QC_Uint32 index){
+	const auto table = vm->builtinTable.load(std::memory_order_acquire);
+	if(index >= table->fns.size() || !QCVM_SUPER(&table->fns[index])->ptr){
+		return nullptr;
+	}
+
+	return &table->fns[index];
+}
+
+bool qcVMExecNative_unsafe(QC_VM *vm, const QC_VM_Fn_Native *fn, QC_Uint32 nargs, QC_Value *args, QC_Value *ret);
+
+bool qcvm_link(QC_VM *vm, const QC_ByteCode *bc, QC_Uint32 loadFlags);
+bool qcvm_linkedFnIndex(const QC_VM *vm, const QC_VM_Fn_Bytecode *fn, QC_Uint32 *ret);
+bool qcvm_prepareFn(QC_VM *vm, QC_Uint32 entry);
+
+//! Make sure the body at \p entry is validated and decoded before running it
+static inline bool qcvm_ensureFn(QC_VM *vm, QC_Uint32 entry){
+	if(std::atomic_ref<QC_Uint8>(vm->codeState[entry]).load(std::memory_order_acquire) == QCVM_CODE_READY) [[likely]]{
+		return true;
+	}
+
+	return qcvm_prepareFn(vm, entry);
+}
+
+QC_Entity qcvm_findRadius(QC_VM *vm, QC_Vector org, QC_Float rad);
+QC_Entity qcvm_find(QC_VM *vm, QC_Entity start, QC_Uint32 field, QC_String match);
+QC_Entity qcvm_nextEnt(QC_VM *vm, QC_Entity ent);
+
+//! Look up QC_VM::thinkDefs after loading bytecode
+void qcvm_resolveThinkDefs(QC_VM *vm);
+
+//! Run \p fn nested, going through QC_VM::memo if it is pure
+bool qcvm_exec(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 fnIdx, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret);
+
+bool qcvm_execLinked(QC_VM *vm, QC_Uint32 fnIdx, QC_Uint32 nArgs, const QC_Value *args, QC_Value *ret);
+
+bool qcvm_execWide(QC_VM *vm, QC_Uint32 fnIdx, QC_Uint32 nLanes, QC_Uint32 nArgs, QC_Value *args, QC_Value *rets);
+
+bool qcvm_reorderBlocks(QC_VM *vm);
+bool qcvm_relayoutGlobals(QC_VM *vm);
+
+QC_Uint32 qcvm_typeSlots(QC_Uint32 type);
+QC_Uint32 qcvm_opGlobalOperands(QC_Uint32 op);
+QC_Uint32 qcvm_opOffsetOperands(QC_Uint32 op);
+
+//! Slots read or written through each operand, too wide is only less precise
+void qcvm_opOperandSlots(QC_Uint32 op, QC_Uint32 *ret);
+
+//! Mirror the decoded statements [\p begin, \p end) into QC_VM::compactCode
+void qcvm_compactStmts(QC_VM *vm, QC_Uint32 begin, QC_Uint32 end);
+
+}
+
+#endif // !QCVM_VM_IMPL_HPP
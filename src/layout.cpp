@@ -0,0 +1,556 @@
+#define QCVM_IMPLEMENTATION
+
+#include "qcvm/vm_impl.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+extern "C" {
+
+static inline bool qcvm_isCondBranch(QC_Uint32 op){
+	return op == QC_OP_IF || op == QC_OP_IFNOT || op == QC_OP_IF_S || op == QC_OP_IFNOT_S
+		|| op == QC_OP_IF_F || op == QC_OP_IFNOT_F;
+}
+
+static inline QC_Uint32 qcvm_invertBranch(QC_Uint32 op){
+	switch(op){
+		case QC_OP_IF: return QC_OP_IFNOT;
+		case QC_OP_IFNOT: return QC_OP_IF;
+		case QC_OP_IF_S: return QC_OP_IFNOT_S;
+		case QC_OP_IFNOT_S: return QC_OP_IF_S;
+		case QC_OP_IF_F: return QC_OP_IFNOT_F;
+		case QC_OP_IFNOT_F: return QC_OP_IF_F;
+		default: return op;
+	}
+}
+
+static inline bool qcvm_isTerminator(QC_Uint32 op){
+	return op == QC_OP_DONE || op == QC_OP_RETURN;
+}
+
+static inline bool qcvm_endsBlock(QC_Uint32 op){
+	return op == QC_OP_GOTO || qcvm_isCondBranch(op) || qcvm_isTerminator(op);
+}
+
+#define QCVM_NO_BLOCK UINT32_MAX
+
+struct QC_VM_Block{
+	QC_Uint32 begin, end; // old statements in QC_VM::code
+	QC_Uint64 count;
+	QC_Uint32 fallthrough, taken;
+	QC_Uint64 fallthroughWeight, takenWeight;
+
+	bool placed;
+	bool invert; // conditional branch now jumps to its old fallthrough
+	bool dropGoto; // trailing goto targets the next block
+	bool needGoto; // old fallthrough is no longer the next block
+	QC_Uint32 pos; // new statement
+};
+
+struct QC_VM_FnLayout{
+	QC_Uint32 entry;
+	std::vector<QC_VM_Block> blocks;
+	std::vector<QC_Uint32> hot, cold;
+};
+
+/**
+ * Split everything reachable from \p entry into basic blocks.
+ * @param marks Scratch space with one zeroed byte per statement, zeroed again before returning
+ */
+static bool qcvm_buildBlocks(const QC_VM *vm, QC_Uint32 entry, std::vector<QC_Uint8> &marks, QC_VM_FnLayout *ret){
+	enum: QC_Uint8{ REACHED = 0x1, LEADER = 0x2 };
+
+	const auto code = vm->code.data();
+	const auto numStmts = QC_Uint32(vm->code.size());
+	const auto profile = vm->stmtProfile.data();
+
+	std::vector<QC_Uint32> reached, pending;
+	bool valid = true;
+
+	const auto visit = [&](QC_Int64 pc, bool leader){
+		if(pc < 0 || pc >= numStmts){
+			valid = false;
+			return;
+		}
+
+		if(leader) marks[pc] |= LEADER;
+
+		if(!(marks[pc] & REACHED)){
+			marks[pc] |= REACHED;
+			reached.emplace_back(QC_Uint32(pc));
+			pending.emplace_back(QC_Uint32(pc));
+		}
+	};
+
+	visit(entry, true);
+
+	while(!pending.empty() && valid){
+		const auto pc = pending.back();
+		pending.pop_back();
+
+		const auto st = code + pc;
+
+		if(st->op == QC_OP_GOTO){
+			visit(QC_Int64(pc) + QC_Int32(st->a), true);
+		}
+		else if(qcvm_isCondBranch(st->op)){
+			visit(QC_Int64(pc) + QC_Int32(st->b), true);
+			visit(QC_Int64(pc) + 1, true);
+		}
+		else if(!qcvm_isTerminator(st->op)){
+			visit(QC_Int64(pc) + 1, false);
+		}
+	}
+
+	std::sort(reached.begin(), reached.end());
+
+	ret->entry = entry;
+	ret->blocks.clear();
+
+	FlatHashMap<QC_Uint32, QC_Uint32> blockOf;
+
+	for(std::size_t i = 0; i < reached.size() && valid; i++){
+		const auto pc = reached[i];
+
+		if(ret->blocks.empty() || reached[i - 1] != pc - 1 || (marks[pc] & LEADER) || qcvm_endsBlock(code[pc - 1].op)){
+			blockOf.emplace(pc, QC_Uint32(ret->blocks.size()));
+
+			QC_VM_Block block;
+			std::memset(&block, 0, sizeof(block));
+			block.begin = pc;
+			block.count = profile[pc].hits;
+			ret->blocks.emplace_back(block);
+		}
+
+		ret->blocks.back().end = pc + 1;
+	}
+
+	for(const auto pc : reached){
+		marks[pc] = 0;
+	}
+
+	if(!valid){
+		return false;
+	}
+
+	for(auto &block : ret->blocks){
+		const auto last = block.end - 1;
+		const auto st = code + last;
+		const auto hits = profile[last].hits;
+		const auto taken = QC_MIN(profile[last].taken, hits);
+
+		block.fallthrough = QCVM_NO_BLOCK;
+		block.taken = QCVM_NO_BLOCK;
+
+		if(st->op == QC_OP_GOTO){
+			block.taken = blockOf.at(QC_Uint32(QC_Int64(last) + QC_Int32(st->a)));
+			block.takenWeight = hits;
+		}
+		else if(qcvm_isCondBranch(st->op)){
+			block.taken = blockOf.at(QC_Uint32(QC_Int64(last) + QC_Int32(st->b)));
+			block.takenWeight = taken;
+			block.fallthrough = blockOf.at(last + 1);
+			block.fallthroughWeight = hits - taken;
+		}
+		else if(!qcvm_isTerminator(st->op)){
+			block.fallthrough = blockOf.at(last + 1);
+			block.fallthroughWeight = hits;
+		}
+	}
+
+	return true;
+}
+
+//! Chain blocks along their hottest edges starting at the entry, blocks that never ran are left cold
+static void qcvm_chainBlocks(QC_VM_FnLayout *layout){
+	auto &blocks = layout->blocks;
+
+	layout->hot.clear();
+	layout->cold.clear();
+
+	// relocated bodies may have blocks before their entry
+	auto cur = QC_Uint32(0);
+	for(QC_Uint32 i = 0; i < blocks.size(); i++){
+		if(blocks[i].begin == layout->entry){
+			cur = i;
+			break;
+		}
+	}
+
+	for(;;){
+		blocks[cur].placed = true;
+		layout->hot.emplace_back(cur);
+
+		auto next = QCVM_NO_BLOCK;
+		QC_Uint64 nextWeight = 0;
+
+		const auto consider = [&](QC_Uint32 succ, QC_Uint64 weight){
+			if(succ != QCVM_NO_BLOCK && !blocks[succ].placed && weight > nextWeight){
+				next = succ;
+				nextWeight = weight;
+			}
+		};
+
+		consider(blocks[cur].fallthrough, blocks[cur].fallthroughWeight);
+		consider(blocks[cur].taken, blocks[cur].takenWeight);
+
+		if(next == QCVM_NO_BLOCK){
+			// start a new chain at the hottest block left
+			for(QC_Uint32 i = 0; i < blocks.size(); i++){
+				if(!blocks[i].placed && blocks[i].count > nextWeight){
+					next = i;
+					nextWeight = blocks[i].count;
+				}
+			}
+		}
+
+		if(next == QCVM_NO_BLOCK){
+			break;
+		}
+
+		cur = next;
+	}
+
+	for(QC_Uint32 i = 0; i < blocks.size(); i++){
+		if(!blocks[i].placed){
+			layout->cold.emplace_back(i);
+		}
+	}
+}
+
+//! Decide how each block ends when laid out in \p order
+static void qcvm_fixupBlocks(const QC_VM *vm, QC_VM_FnLayout *layout, const std::vector<QC_Uint32> &order){
+	for(std::size_t i = 0; i < order.size(); i++){
+		auto &block = layout->blocks[order[i]];
+		const auto next = i + 1 < order.size() ? order[i + 1] : QCVM_NO_BLOCK;
+		const auto op = vm->code[block.end - 1].op;
+
+		if(op == QC_OP_GOTO){
+			block.dropGoto = block.taken == next;
+		}
+		else if(qcvm_isCondBranch(op)){
+			if(block.fallthrough != next && block.taken == next){
+				block.invert = true;
+			}
+			else{
+				block.needGoto = block.fallthrough != next;
+			}
+		}
+		else if(block.fallthrough != QCVM_NO_BLOCK){
+			block.needGoto = block.fallthrough != next;
+		}
+	}
+}
+
+static QC_Uint32 qcvm_placeBlocks(QC_VM_FnLayout *layout, const std::vector<QC_Uint32> &order, QC_Uint32 pos){
+	for(const auto idx : order){
+		auto &block = layout->blocks[idx];
+		block.pos = pos;
+		pos += (block.end - block.begin) - block.dropGoto + block.needGoto;
+	}
+
+	return pos;
+}
+
+static void qcvm_emitBlocks(
+	const QC_VM *vm, const QC_VM_FnLayout *layout, const std::vector<QC_Uint32> &order,
+	std::vector<QC_ByteCodeStatement> &code, std::vector<QC_VM_StmtProfile> &profile
+){
+	const auto &blocks = layout->blocks;
+
+	const auto emit = [&](const QC_ByteCodeStatement &st, const QC_VM_StmtProfile &counts){
+		code.emplace_back(st);
+		profile.emplace_back(counts);
+	};
+
+	for(const auto idx : order){
+		const auto &block = blocks[idx];
+		const auto last = block.end - 1;
+
+		for(auto pc = block.begin; pc < last; pc++){
+			emit(vm->code[pc], vm->stmtProfile[pc]);
+		}
+
+		auto st = vm->code[last];
+		auto counts = vm->stmtProfile[last];
+		const auto newPc = QC_Int64(block.pos) + (last - block.begin);
+
+		if(st.op == QC_OP_GOTO){
+			if(!block.dropGoto){
+				st.a = QC_Uint32(QC_Int32(QC_Int64(blocks[block.taken].pos) - newPc));
+				emit(st, counts);
+			}
+		}
+		else if(qcvm_isCondBranch(st.op)){
+			auto target = block.taken;
+
+			if(block.invert){
+				st.op = qcvm_invertBranch(st.op);
+				counts.taken = counts.hits - QC_MIN(counts.taken, counts.hits);
+				target = block.fallthrough;
+			}
+
+			st.b = QC_Uint32(QC_Int32(QC_Int64(blocks[target].pos) - newPc));
+			emit(st, counts);
+		}
+		else{
+			emit(st, counts);
+		}
+
+		if(block.needGoto){
+			const auto gotoPc = QC_Int64(block.pos) + (block.end - block.begin) - block.dropGoto;
+			const QC_ByteCodeStatement jump = {
+				.op = QC_OP_GOTO,
+				.a = QC_Uint32(QC_Int32(QC_Int64(blocks[block.fallthrough].pos) - gotoPc)),
+				.b = 0, .c = 0
+			};
+
+			emit(jump, QC_VM_StmtProfile{ .hits = block.fallthroughWeight, .taken = block.fallthroughWeight });
+		}
+	}
+}
+
+/**
+ * Reorder the blocks of every profiled, decoded function.
+ *
+ * Reordered bodies are appended to the code image with the hot chains of every function first and all cold blocks
+ * after them, the old bodies are left in place but no longer referenced.
+ */
+bool qcvm_reorderBlocks(QC_VM *vm){
+	if(vm->stmtProfile.size() != vm->code.size()){
+		qcLogError("no statement profile recorded");
+		return false;
+	}
+
+	std::vector<QC_Uint32> entries;
+
+	for(const auto &linkedFn : vm->fnTable){
+		if(
+			linkedFn.fn.base.type == QC_VM_FN_BYTECODE && linkedFn.entry != 0 &&
+			vm->codeState[linkedFn.entry] == QCVM_CODE_READY && vm->stmtProfile[linkedFn.entry].hits > 0
+		){
+			entries.emplace_back(linkedFn.entry);
+		}
+	}
+
+	std::sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+	std::vector<QC_VM_FnLayout> layouts;
+	layouts.reserve(entries.size());
+
+	std::vector<QC_Uint8> marks(vm->code.size(), 0);
+
+	for(const auto entry : entries){
+		auto &layout = layouts.emplace_back();
+		if(!qcvm_buildBlocks(vm, entry, marks, &layout)){
+			// falls outside of the image somewhere, leave it alone
+			layouts.pop_back();
+			continue;
+		}
+
+		qcvm_chainBlocks(&layout);
+	}
+
+	const auto base = QC_Uint32(vm->code.size());
+	auto pos = base;
+
+	for(auto &layout : layouts){
+		qcvm_fixupBlocks(vm, &layout, layout.hot);
+		pos = qcvm_placeBlocks(&layout, layout.hot, pos);
+	}
+
+	for(auto &layout : layouts){
+		qcvm_fixupBlocks(vm, &layout, layout.cold);
+		pos = qcvm_placeBlocks(&layout, layout.cold, pos);
+	}
+
+	std::vector<QC_ByteCodeStatement> code;
+	std::vector<QC_VM_StmtProfile> profile;
+	code.reserve(pos - base);
+	profile.reserve(pos - base);
+
+	for(const auto &layout : layouts){
+		qcvm_emitBlocks(vm, &layout, layout.hot, code, profile);
+	}
+
+	for(const auto &layout : layouts){
+		qcvm_emitBlocks(vm, &layout, layout.cold, code, profile);
+	}
+
+	vm->code.insert(vm->code.end(), code.begin(), code.end());
+	vm->codeState.resize(vm->code.size(), QCVM_CODE_READY);
+	vm->stmtProfile.insert(vm->stmtProfile.end(), profile.begin(), profile.end());
+
+	vm->compactCode.resize(vm->compactValid ? vm->code.size() : 0);
+	qcvm_compactStmts(vm, base, QC_Uint32(vm->code.size()));
+
+	FlatHashMap<QC_Uint32, QC_Uint32> newEntries;
+	for(const auto &layout : layouts){
+		newEntries.emplace(layout.entry, layout.blocks[layout.hot.front()].pos);
+	}
+
+	for(auto &linkedFn : vm->fnTable){
+		if(linkedFn.fn.base.type != QC_VM_FN_BYTECODE) continue;
+
+		const auto res = newEntries.find(linkedFn.entry);
+		if(res != newEntries.end()){
+			linkedFn.entry = res->second;
+		}
+	}
+
+	// compiled from the old bodies
+	vm->wideFns.clear();
+	return true;
+}
+
+/**
+ * Move globals so the most accessed ones share cache lines.
+ *
+ * Slots that are accessed together (multi-slot defs, the locals of a function, vector operands) move as one unit and
+ * the reserved globals stay where they are.
+ */
+bool qcvm_relayoutGlobals(QC_VM *vm){
+	if(vm->globalProfile.empty()){
+		qcLogError("no global profile recorded");
+		return false;
+	}
+
+	const auto numSlots = qcvm_numGlobals(vm);
+	const auto numFixed = QCVM_NUM_RESERVED_GLOBALS;
+
+	vm->globalProfile.resize(numSlots);
+
+	// end of the slots that have to stay contiguous with each slot
+	std::vector<QC_Uint32> unitEnd(numSlots);
+	std::iota(unitEnd.begin(), unitEnd.end(), 1u);
+
+	const auto join = [&](QC_Uint32 slot, QC_Uint32 n){
+		if(slot >= numFixed && slot < numSlots){
+			unitEnd[slot] = QC_MAX(unitEnd[slot], QC_MIN(slot + n, numSlots));
+		}
+	};
+
+	for(const auto &mod : vm->modules){
+		const auto defs = qcByteCodeDefs(mod.bc);
+		const auto nDefs = qcByteCodeNumDefs(mod.bc);
+		const auto nGlobals = QC_Uint32(mod.globalMap.size());
+
+		for(QC_Uintptr i = 0; i < nDefs; i++){
+			const auto n = qcvm_typeSlots(defs[i].type & ~QCVM_DEF_SAVEGLOBAL);
+			if(n > 1 && defs[i].globalIdx + n <= nGlobals){
+				join(mod.globalMap[defs[i].globalIdx], n);
+			}
+		}
+	}
+
+	for(const auto &linkedFn : vm->fnTable){
+		if(linkedFn.fn.base.type == QC_VM_FN_BYTECODE && linkedFn.numLocals > 1){
+			join(linkedFn.localIdx, linkedFn.numLocals);
+		}
+	}
+
+	// code that is still raw refers to module globals and is remapped through the module when decoded
+	const auto isDecoded = [vm](QC_Uint32 pc){ return vm->codeState[pc] == QCVM_CODE_READY; };
+
+	for(QC_Uint32 pc = 0; pc < vm->code.size(); pc++){
+		if(!isDecoded(pc)) continue;
+
+		const auto &st = vm->code[pc];
+		const auto operands = qcvm_opGlobalOperands(st.op);
+		const QC_Uint32 slots[] = { st.a, st.b, st.c };
+
+		QC_Uint32 widths[3];
+		qcvm_opOperandSlots(st.op, widths);
+
+		for(QC_Uint32 j = 0; j < 3; j++){
+			if(operands & (1u << j)) join(slots[j], widths[j]);
+		}
+	}
+
+	struct Unit{
+		QC_Uint32 begin, end;
+		QC_Uint64 count;
+	};
+
+	std::vector<Unit> units;
+
+	for(auto i = numFixed; i < numSlots;){
+		Unit unit = { .begin = i, .end = unitEnd[i], .count = 0 };
+
+		for(auto j = i; j < unit.end; j++){
+			unit.end = QC_MAX(unit.end, unitEnd[j]);
+			unit.count += vm->globalProfile[j];
+		}
+
+		units.emplace_back(unit);
+		i = unit.end;
+	}
+
+	// hottest first, globals that were never accessed keep their order
+	std::stable_sort(units.begin(), units.end(), [](const Unit &lhs, const Unit &rhs){ return lhs.count > rhs.count; });
+
+	std::vector<QC_Uint32> remap(numSlots);
+	std::iota(remap.begin(), remap.begin() + numFixed, 0u);
+
+	auto pos = numFixed;
+	for(const auto &unit : units){
+		for(auto j = unit.begin; j < unit.end; j++){
+			remap[j] = pos++;
+		}
+	}
+
+	std::vector<QC_VM_Slot> globalMem(numSlots + QCVM_GLOBAL_PADDING);
+	std::vector<QC_Uint64> globalProfile(numSlots);
+
+	for(QC_Uint32 i = 0; i < numSlots; i++){
+		globalMem[remap[i]] = vm->globalMem[i];
+		globalProfile[remap[i]] = vm->globalProfile[i];
+	}
+
+	vm->globalMem = std::move(globalMem);
+	vm->globalProfile = std::move(globalProfile);
+
+	const auto remapSlot = [&](QC_Uint32 &slot){
+		if(slot < numSlots) slot = remap[slot];
+	};
+
+	for(QC_Uint32 pc = 0; pc < vm->code.size(); pc++){
+		if(!isDecoded(pc)) continue;
+
+		auto &st = vm->code[pc];
+		const auto operands = qcvm_opGlobalOperands(st.op);
+
+		if(operands & 0x1) remapSlot(st.a);
+		if(operands & 0x2) remapSlot(st.b);
+		if(operands & 0x4) remapSlot(st.c);
+
+		qcvm_compactStmts(vm, pc, pc + 1);
+	}
+
+	for(auto &mod : vm->modules){
+		for(auto &slot : mod.globalMap){
+			remapSlot(slot);
+		}
+	}
+
+	for(auto &linkedFn : vm->fnTable){
+		remapSlot(linkedFn.localIdx);
+	}
+
+	for(auto &global : vm->globals.values){
+		remapSlot(global.slot);
+	}
+
+	for(auto &global : vm->globalHandles){
+		remapSlot(global.slot);
+	}
+
+	qcvm_resolveThinkDefs(vm);
+
+	// compiled against the old slots
+	vm->wideFns.clear();
+	return true;
+}
+
+}
@@ -0,0 +1,632 @@
+#define QCVM_IMPLEMENTATION
+
+#include "qcvm/vm_impl.hpp"
+
+#include <algorithm>
+
+extern "C" {
+
+QC_Uint32 qcvm_typeSlots(QC_Uint32 type){
+	switch(type){
+		case QC_BYTECODE_TYPE_VOID: return 0;
+		case QC_BYTECODE_TYPE_VECTOR: return 3;
+
+		case QC_BYTECODE_TYPE_INT64:
+		case QC_BYTECODE_TYPE_UINT64:
+		case QC_BYTECODE_TYPE_DOUBLE:
+			return 2;
+
+		default: return 1;
+	}
+}
+
+// bitmask of the operands (a = 0x1, b = 0x2, c = 0x4) that refer to globals rather than holding immediates
+QC_Uint32 qcvm_opGlobalOperands(QC_Uint32 op){
+	switch(op){
+		case QC_OP_GOTO: return 0x0;
+
+		case QC_OP_IF:
+		case QC_OP_IFNOT:
+		case QC_OP_IF_S:
+		case QC_OP_IFNOT_S:
+		case QC_OP_IF_F:
+		case QC_OP_IFNOT_F:
+		case QC_OP_SWITCH_F:
+		case QC_OP_SWITCH_V:
+		case QC_OP_SWITCH_S:
+		case QC_OP_SWITCH_E:
+		case QC_OP_SWITCH_FNC:
+		case QC_OP_SWITCH_I:
+		case QC_OP_CASE:
+			return 0x1 | 0x4;
+
+		case QC_OP_CASERANGE: return 0x1 | 0x2;
+
+		case QC_OP_BOUNDCHECK:
+		case QC_OP_PUSH:
+		case QC_OP_POP:
+			return 0x0;
+
+		default: return 0x1 | 0x2 | 0x4;
+	}
+}
+
+void qcvm_opOperandSlots(QC_Uint32 op, QC_Uint32 *ret){
+	ret[0] = ret[1] = ret[2] = 1;
+
+	switch(op){
+		// returns and parameters are always copied as vectors
+		case QC_OP_DONE:
+		case QC_OP_RETURN:
+		case QC_OP_NOT_V:
+		case QC_OP_STOREP_V:
+			ret[0] = 3;
+			break;
+
+		case QC_OP_CALL1H:
+			ret[1] = 3;
+			break;
+
+		case QC_OP_CALL2H: case QC_OP_CALL3H: case QC_OP_CALL4H: case QC_OP_CALL5H:
+		case QC_OP_CALL6H: case QC_OP_CALL7H: case QC_OP_CALL8H:
+			ret[1] = ret[2] = 3;
+			break;
+
+		case QC_OP_MUL_V:
+		case QC_OP_EQ_V:
+		case QC_OP_NE_V:
+		case QC_OP_STORE_V:
+			ret[0] = ret[1] = 3;
+			break;
+
+		case QC_OP_MUL_FV:
+			ret[1] = ret[2] = 3;
+			break;
+
+		case QC_OP_MUL_VF:
+		case QC_OP_DIV_VF:
+			ret[0] = ret[2] = 3;
+			break;
+
+		case QC_OP_LOAD_V:
+			ret[2] = 3;
+			break;
+
+		case QC_OP_ADD_V:
+		case QC_OP_SUB_V:
+			ret[0] = ret[1] = ret[2] = 3;
+			break;
+
+		default: break;
+	}
+}
+
+void qcvm_compactStmts(QC_VM *vm, QC_Uint32 begin, QC_Uint32 end){
+	if(!vm->compactValid.load(std::memory_order_relaxed)){
+		return;
+	}
+
+	for(auto i = begin; i < end; i++){
+		const auto &stmt = vm->code[i];
+		const auto offsets = qcvm_opOffsetOperands(stmt.op);
+
+		const auto fits = [offsets](QC_Uint32 operand, QC_Uint32 bit){
+			return (offsets & bit) ? (QC_Int32(operand) >= INT16_MIN && QC_Int32(operand) <= INT16_MAX) : operand <= UINT16_MAX;
+		};
+
+		if(stmt.op > UINT16_MAX || !fits(stmt.a, 0x1) || !fits(stmt.b, 0x2) || !fits(stmt.c, 0x4)){
+			// for good, running code switches over after its next call
+			vm->compactValid.store(false, std::memory_order_relaxed);
+			return;
+		}
+
+		vm->compactCode[i] = QC_ByteCodeStatement16{
+			.op = QC_Uint16(stmt.op), .a = QC_Uint16(stmt.a), .b = QC_Uint16(stmt.b), .c = QC_Uint16(stmt.c)
+		};
+	}
+}
+
+static inline bool qcvm_isShareableName(std::string_view name){
+	return !name.empty() && name != "IMMEDIATE";
+}
+
+bool qcvm_linkedFnIndex(const QC_VM *vm, const QC_VM_Fn_Bytecode *fn, QC_Uint32 *ret){
+	for(const auto &mod : vm->modules){
+		if(mod.bc != fn->bc){
+			continue;
+		}
+
+		const auto fns = qcByteCodeFunctions(mod.bc);
+		const auto nFns = qcByteCodeNumFunctions(mod.bc);
+
+		if(fn->fn < fns || fn->fn >= (fns + nFns)){
+			return false;
+		}
+
+		*ret = mod.fnBase + QC_Uint32(fn->fn - fns);
+		return true;
+	}
+
+	return false;
+}
+
+static inline bool qcvm_isJump(QC_Uint32 op){
+	return op == QC_OP_GOTO || op == QC_OP_IF || op == QC_OP_IFNOT || op == QC_OP_IF_S || op == QC_OP_IFNOT_S
+		|| op == QC_OP_IF_F || op == QC_OP_IFNOT_F;
+}
+
+// module relative end of the body starting at `begin`
+static inline QC_Uint32 qcvm_bodyEnd(const std::vector<QC_Uint32> &entries, QC_Uint32 begin, QC_Uint32 end){
+	const auto next = std::upper_bound(entries.begin(), entries.end(), begin);
+	return next == entries.end() ? end : QC_MIN(*next, end);
+}
+
+/**
+ * Validate a function body before it is decoded.
+ * @param stmts Undecoded statements of the function's module
+ */
+static bool qcvm_validateBody(const QC_ByteCodeStatement *stmts, QC_Uint32 begin, QC_Uint32 end, QC_Uint32 nGlobals){
+	// execution must never fall through into the next body or off the end of the code
+	const auto lastOp = begin < end ? stmts[end - 1].op : QC_Uint32(QC_OP_COUNT);
+	if(lastOp != QC_OP_DONE && lastOp != QC_OP_RETURN && lastOp != QC_OP_GOTO){
+		qcLogError("function at statement %u does not end in a return or jump", begin);
+		return false;
+	}
+
+	for(QC_Uint32 i = begin; i < end; i++){
+		const auto stmt = stmts + i;
+
+		if(stmt->op >= QC_OP_COUNT){
+			qcLogError("statement %u has unknown instruction 0x%x", i, stmt->op);
+			return false;
+		}
+
+		const auto operands = qcvm_opGlobalOperands(stmt->op);
+		const QC_Uint64 slots[] = { stmt->a, stmt->b, stmt->c };
+
+		QC_Uint32 widths[3];
+		qcvm_opOperandSlots(stmt->op, widths);
+
+		// returns and parameters copy 3 slots of any type, QCVM_GLOBAL_PADDING keeps that in bounds for scalars
+		const auto copiesSlots = stmt->op == QC_OP_DONE || stmt->op == QC_OP_RETURN || (stmt->op >= QC_OP_CALL1H && stmt->op <= QC_OP_CALL8H);
+		const auto limit = nGlobals + (copiesSlots ? QCVM_GLOBAL_PADDING : 0u);
+
+		for(QC_Uint32 j = 0; j < 3; j++){
+			if((operands & (1u << j)) && slots[j] + widths[j] > limit){
+				qcLogError("statement %u refers to a global outside of the %u globals in its module", i, nGlobals);
+				return false;
+			}
+		}
+
+		if(qcvm_isJump(stmt->op)){
+			const auto target = QC_Int64(i) + QC_Int32(stmt->op == QC_OP_GOTO ? stmt->a : stmt->b);
+			if(target < begin || target >= end){
+				qcLogError("statement %u jumps outside of its function", i);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void qcvm_decodeBody(QC_VM *vm, const QC_VM_Module *mod, QC_Uint32 begin, QC_Uint32 end){
+	for(QC_Uint32 i = begin; i < end; i++){
+		auto &stmt = vm->code[i];
+		const auto operands = qcvm_opGlobalOperands(stmt.op);
+
+		if(operands & 0x1) stmt.a = mod->globalMap[stmt.a];
+		if(operands & 0x2) stmt.b = mod->globalMap[stmt.b];
+		if(operands & 0x4) stmt.c = mod->globalMap[stmt.c];
+
+		// the entry is published by the caller, the rest tells decoded statements apart from raw module code
+		if(i != begin) vm->codeState[i] = QCVM_CODE_READY;
+	}
+
+	qcvm_compactStmts(vm, begin, end);
+}
+
+bool qcvm_prepareFn(QC_VM *vm, QC_Uint32 entry){
+	const std::atomic_ref<QC_Uint8> state(vm->codeState[entry]);
+
+	for(;;){
+		auto expected = QC_Uint8(QCVM_CODE_PENDING);
+		if(state.compare_exchange_strong(expected, QCVM_CODE_BUSY, std::memory_order_acquire)){
+			break;
+		}
+		else if(expected == QCVM_CODE_READY){
+			return true;
+		}
+		else if(expected == QCVM_CODE_INVALID){
+			qcLogError("function at statement %u failed validation", entry);
+			return false;
+		}
+
+		// another thread is decoding it
+		state.wait(QCVM_CODE_BUSY, std::memory_order_acquire);
+	}
+
+	const auto mod = std::find_if(vm->modules.begin(), vm->modules.end(), [entry](const QC_VM_Module &mod){
+		return entry >= mod.stmtBase && entry < mod.stmtEnd;
+	});
+
+	auto newState = QCVM_CODE_INVALID;
+
+	if(mod != vm->modules.end()){
+		const auto end = qcvm_bodyEnd(mod->entries, entry, mod->stmtEnd);
+		const auto stmts = vm->code.data() + mod->stmtBase;
+
+		if(qcvm_validateBody(stmts, entry - mod->stmtBase, end - mod->stmtBase, QC_Uint32(mod->globalMap.size()))){
+			qcvm_decodeBody(vm, &*mod, entry, end);
+			newState = QCVM_CODE_READY;
+		}
+	}
+
+	state.store(newState, std::memory_order_release);
+	state.notify_all();
+
+	if(newState != QCVM_CODE_READY){
+		qcLogError("function at statement %u failed validation", entry);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Append a module to the linked image.
+ *
+ * Reserved globals are shared by every module, named globals outside of function locals are shared by name
+ * and everything else is given a fresh slot. Entity fields are linked the same way into one entity block.
+ * Statements are copied with their global operands remapped and function/string/field globals are rewritten
+ * to linked function indices, VM string buffer indices and linked field offsets.
+ */
+bool qcvm_link(QC_VM *vm, const QC_ByteCode *bc, QC_Uint32 loadFlags){
+	const auto strBuf = qcByteCodeStrings(bc);
+
+	const auto stmts = qcByteCodeStatements(bc);
+	const auto nStmts = qcByteCodeNumStatements(bc);
+
+	const auto fns = qcByteCodeFunctions(bc);
+	const auto nFns = qcByteCodeNumFunctions(bc);
+
+	const auto defs = qcByteCodeDefs(bc);
+	const auto nDefs = qcByteCodeNumDefs(bc);
+
+	const auto globals = qcByteCodeGlobals(bc);
+	const auto nGlobals = QC_Uint32(qcByteCodeNumGlobals(bc));
+
+	const auto fields = qcByteCodeFields(bc);
+	const auto nFields = qcByteCodeNumFields(bc);
+
+	const auto globalBase = qcvm_numGlobals(vm) - QCVM_NUM_RESERVED_GLOBALS;
+	const auto stmtBase = QC_Uint32(vm->code.size());
+	const auto fnBase = QC_Uint32(vm->fnTable.size());
+
+	std::vector<bool> isLocal(nGlobals, false);
+	std::vector<QC_Uint32> slotTypes(nGlobals, QC_BYTECODE_TYPE_VOID);
+
+	for(QC_Uintptr i = 0; i < nFns; i++){
+		const auto fn = fns + i;
+		if(fn->entryPoint <= 0) continue;
+
+		const auto localEnd = QC_MIN(QC_Uint32(fn->localIdx) + fn->numLocals, nGlobals);
+		for(QC_Uint32 j = fn->localIdx; j < localEnd; j++){
+			isLocal[j] = true;
+		}
+	}
+
+	QC_VM_Module mod;
+	mod.bc = bc;
+	mod.stmtBase = stmtBase;
+	mod.fnBase = fnBase;
+	mod.globalMap.resize(nGlobals);
+
+	for(QC_Uint32 i = 0; i < nGlobals; i++){
+		mod.globalMap[i] = i < QCVM_NUM_RESERVED_GLOBALS ? i : globalBase + i;
+	}
+
+	struct SharedDef{
+		QC_Uint32 slot, linkedSlot, numSlots;
+		bool overrides;
+	};
+
+	std::vector<SharedDef> sharedDefs;
+	std::vector<std::pair<std::string_view, QC_VM_Global>> newGlobals;
+
+	// fields are shared by name too, every other slot of the module's entity block is appended to the linked block
+
+	auto nEntityFields = QC_Uint32(qcByteCodeNumEntityFields(bc));
+
+	for(QC_Uintptr i = 0; i < nFields; i++){
+		nEntityFields = QC_MAX(nEntityFields, fields[i].offset + qcvm_typeSlots(fields[i].type));
+	}
+
+	mod.fieldMap.assign(nEntityFields, UINT32_MAX);
+
+	std::vector<std::pair<std::string_view, QC_VM_Global>> newFields;
+
+	for(QC_Uintptr i = 0; i < nFields; i++){
+		const auto field = fields + i;
+		const auto fieldName = std::string_view(strBuf + field->nameIdx);
+
+		if(!qcvm_isShareableName(fieldName)){
+			continue;
+		}
+
+		const auto res = vm->fields.find(fieldName);
+		if(!res){
+			continue;
+		}
+		else if(res->type != field->type){
+			qcLogError(
+				"type of field '%s' (0x%x) does not match previously loaded type 0x%x",
+				strBuf + field->nameIdx, field->type, res->type
+			);
+			return false;
+		}
+
+		for(QC_Uint32 j = 0; j < qcvm_typeSlots(field->type); j++){
+			mod.fieldMap[field->offset + j] = res->slot + j;
+		}
+	}
+
+	auto linkedEntityFields = vm->ents.stride;
+
+	for(auto &linkedOffset : mod.fieldMap){
+		if(linkedOffset == UINT32_MAX){
+			linkedOffset = linkedEntityFields++;
+		}
+	}
+
+	for(QC_Uintptr i = 0; i < nFields; i++){
+		const auto field = fields + i;
+		const auto fieldName = std::string_view(strBuf + field->nameIdx);
+
+		if(qcvm_isShareableName(fieldName) && !vm->fields.find(fieldName)){
+			newFields.emplace_back(fieldName, QC_VM_Global{ .type = field->type, .slot = mod.fieldMap[field->offset] });
+		}
+	}
+
+	// resolve shared globals before touching any VM state
+	for(QC_Uintptr i = 0; i < nDefs; i++){
+		const auto def = defs + i;
+		const auto defType = def->type & ~QCVM_DEF_SAVEGLOBAL;
+		const auto defName = std::string_view(strBuf + def->nameIdx);
+		const auto numSlots = qcvm_typeSlots(defType);
+
+		if(def->globalIdx < QCVM_NUM_RESERVED_GLOBALS || def->globalIdx + numSlots > nGlobals){
+			continue;
+		}
+
+		for(QC_Uint32 j = 0; j < numSlots; j++){
+			slotTypes[def->globalIdx + j] = defType;
+		}
+
+		if(isLocal[def->globalIdx] || !qcvm_isShareableName(defName)){
+			continue;
+		}
+
+		const auto res = vm->globals.find(defName);
+		if(!res){
+			newGlobals.emplace_back(defName, QC_VM_Global{ .type = defType, .slot = globalBase + def->globalIdx });
+			continue;
+		}
+		else if(res->type != defType){
+			qcLogError(
+				"type of global '%s' (0x%x) does not match previously loaded type 0x%x",
+				strBuf + def->nameIdx, defType, res->type
+			);
+			return false;
+		}
+
+		const auto overrideFlag = defType == QC_BYTECODE_TYPE_FUNC ? QC_VM_LOAD_OVERRIDE_FNS : QC_VM_LOAD_OVERRIDE_GLOBALS;
+
+		sharedDefs.emplace_back(SharedDef{
+			.slot = def->globalIdx,
+			.linkedSlot = res->slot,
+			.numSlots = numSlots,
+			.overrides = (loadFlags & overrideFlag) != 0
+		});
+
+		for(QC_Uint32 j = 0; j < numSlots; j++){
+			mod.globalMap[def->globalIdx + j] = res->slot + j;
+		}
+	}
+
+	for(QC_Uintptr i = 0; i < nFns; i++){
+		const auto fn = fns + i;
+
+		if(fn->entryPoint > 0 && fn->numLocals && (QC_Uint32(fn->localIdx) + fn->numLocals) > nGlobals){
+			qcLogError("locals of function '%s' are outside of the %u globals in its module", strBuf + fn->nameIdx, nGlobals);
+			return false;
+		}
+		else if(fn->entryPoint > 0 && QC_Uint32(fn->entryPoint) >= nStmts){
+			qcLogError("invalid entry point %d for function '%s'", fn->entryPoint, strBuf + fn->nameIdx);
+			return false;
+		}
+		else if(fn->numLocals > (QCVM_STACK_GUARD_BYTES / sizeof(QC_VM_Slot))){
+			// saving more than this could skip over the stack guard
+			qcLogError("function '%s' has too many locals (%u)", strBuf + fn->nameIdx, fn->numLocals);
+			return false;
+		}
+	}
+
+	std::vector<QC_Uint32> entries;
+
+	for(QC_Uintptr i = 0; i < nFns; i++){
+		if(fns[i].entryPoint > 0){
+			entries.emplace_back(QC_Uint32(fns[i].entryPoint));
+		}
+	}
+
+	std::sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+	// lazily loaded bodies are validated on their first call instead
+	if(!(loadFlags & QC_VM_LOAD_LAZY)){
+		for(const auto entry : entries){
+			if(!qcvm_validateBody(stmts, entry, qcvm_bodyEnd(entries, entry, QC_Uint32(nStmts)), nGlobals)){
+				return false;
+			}
+		}
+	}
+
+	for(QC_Uint32 i = QCVM_NUM_RESERVED_GLOBALS; i < nGlobals; i++){
+		if(slotTypes[i] == QC_BYTECODE_TYPE_STRING && globals[i].u32 >= qcByteCodeStringsSize(bc)){
+			qcLogError("string global %u has offset %u outside of the string table", i, globals[i].u32);
+			return false;
+		}
+	}
+
+	// link values
+
+	const auto linkValue = [&](QC_Uint32 slot) -> QC_VM_Slot{
+		QC_VM_Slot val = { .u32 = globals[slot].u32 };
+
+		switch(slotTypes[slot]){
+			case QC_BYTECODE_TYPE_FUNC:{
+				if(val.u32 != 0){
+					val.u32 += fnBase;
+				}
+				break;
+			}
+
+			case QC_BYTECODE_TYPE_FIELD:{
+				if(val.u32 < mod.fieldMap.size()){
+					val.u32 = mod.fieldMap[val.u32];
+				}
+				break;
+			}
+
+			case QC_BYTECODE_TYPE_STRING:{
+				if(strBuf[val.u32] == '\0'){
+					// every empty string is the null string
+					val.u32 = 0;
+				}
+				else{
+					const auto str = std::string_view(strBuf + val.u32);
+					val.u32 = qcStringBufferEmplace(vm->strBuf, QC_StrView{ str.data(), str.size() });
+				}
+				break;
+			}
+
+			default: break;
+		}
+
+		return val;
+	};
+
+	if(!vm->ents.setStride(linkedEntityFields) || !vm->ents.reserve()){
+		qcLogError("failed to make room for %u entity fields", linkedEntityFields);
+		return false;
+	}
+
+	vm->globalMem.resize(globalBase + nGlobals + QCVM_GLOBAL_PADDING);
+
+	for(QC_Uint32 i = QCVM_NUM_RESERVED_GLOBALS; i < nGlobals; i++){
+		vm->globalMem[globalBase + i] = linkValue(i);
+	}
+
+	for(const auto &shared : sharedDefs){
+		if(!shared.overrides) continue;
+
+		for(QC_Uint32 j = 0; j < shared.numSlots; j++){
+			vm->globalMem[shared.linkedSlot + j] = linkValue(shared.slot + j);
+		}
+	}
+
+	for(const auto &newGlobal : newGlobals){
+		*vm->globals.tryEmplace(newGlobal.first).first = newGlobal.second;
+	}
+
+	for(const auto &newField : newFields){
+		const auto res = vm->fields.tryEmplace(newField.first);
+		if(res.second) *res.first = newField.second;
+	}
+
+	// link code, bodies are decoded in place
+
+	vm->code.insert(vm->code.end(), stmts, stmts + nStmts);
+	vm->codeState.resize(vm->code.size(), QCVM_CODE_PENDING);
+
+	// sized up-front so decoding never reallocates it under running code
+	vm->compactCode.resize(vm->compactValid ? vm->code.size() : 0);
+
+	for(QC_Uintptr i = 0; i < nStmts; i++){
+		vm->dialect = QC_MAX(vm->dialect, qcvm_opDialect(stmts[i].op));
+	}
+
+	if(vm->profiling){
+		vm->stmtProfile.resize(vm->code.size());
+		vm->globalProfile.resize(qcvm_numGlobals(vm));
+	}
+
+	mod.stmtEnd = QC_Uint32(vm->code.size());
+	mod.entries.reserve(entries.size());
+
+	for(const auto entry : entries){
+		mod.entries.emplace_back(stmtBase + entry);
+	}
+
+	// rebuild the call descriptor table
+
+	vm->fnTable.reserve(vm->fnTable.size() + nFns);
+
+	for(QC_Uintptr i = 0; i < nFns; i++){
+		const auto fn = fns + i;
+		const auto fnName = std::string_view(strBuf + fn->nameIdx);
+
+		QC_VM_LinkedFn linkedFn;
+		std::memset(&linkedFn, 0, sizeof(linkedFn));
+
+		linkedFn.numArgs = QC_Uint32(fn->numArgs);
+		std::memcpy(linkedFn.argSizes, fn->argSizes, sizeof(linkedFn.argSizes));
+
+		if(fn->entryPoint > 0){
+			linkedFn.fn.bytecode = QC_VM_Fn_Bytecode{
+				.QCVM_SUPER_MEMBER = QC_VM_Fn{ .type = QC_VM_FN_BYTECODE, .nameIdx = 0, .flags = 0 },
+				.bc = bc,
+				.fn = fn
+			};
+
+			linkedFn.entry = stmtBase + QC_Uint32(fn->entryPoint);
+			linkedFn.localIdx = fn->numLocals ? mod.globalMap[fn->localIdx] : 0;
+			linkedFn.numLocals = fn->numLocals;
+		}
+		else if(fn->entryPoint < 0){
+			// resolved against the current builtin table on every call
+			linkedFn.fn.base.type = QC_VM_FN_BUILTIN;
+			linkedFn.fn.builtin.index = QC_Uint32(-fn->entryPoint);
+		}
+		else if(qcvm_isShareableName(fnName)){
+			// declared here but defined by a previously loaded module
+			const auto res = vm->fns.find(fnName);
+			if(res){
+				QC_Uint32 resolvedIdx;
+
+				if(res->base.type != QC_VM_FN_BYTECODE){
+					linkedFn.fn = *res;
+				}
+				else if(qcvm_linkedFnIndex(vm, &res->bytecode, &resolvedIdx)){
+					linkedFn = vm->fnTable[resolvedIdx];
+				}
+			}
+		}
+
+		vm->fnTable.emplace_back(linkedFn);
+	}
+
+	const auto linkedMod = &vm->modules.emplace_back(std::move(mod));
+
+	if(!(loadFlags & QC_VM_LOAD_LAZY)){
+		for(const auto entry : linkedMod->entries){
+			qcvm_decodeBody(vm, linkedMod, entry, qcvm_bodyEnd(linkedMod->entries, entry, linkedMod->stmtEnd));
+			vm->codeState[entry] = QCVM_CODE_READY;
+		}
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,127 @@
+#define QCVM_IMPLEMENTATION
+
+#include "qcvm/vm_impl.hpp"
+
+#ifdef QCVM_STACK_GUARD_PAGES
+
+#include <csignal>
+#include <mutex>
+
+#include <pthread.h>
+
+#include <sys/mman.h>
+
+thread_local QC_VM_StackGuard *qcvm_activeStackGuard = nullptr;
+
+static struct sigaction qcvm_prevSegvAction;
+
+void *qcvm_mapStack(size_t bytes){
+	// reserve everything up-front, pages are only committed when first touched
+	const auto mem = mmap(nullptr, bytes + QCVM_STACK_GUARD_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(mem == MAP_FAILED){
+		qcLogError("failed to map %zu bytes for stack", bytes);
+		return nullptr;
+	}
+
+	if(mprotect(static_cast<char*>(mem) + bytes, QCVM_STACK_GUARD_BYTES, PROT_NONE) != 0){
+		qcLogError("failed to protect stack guard");
+		munmap(mem, bytes + QCVM_STACK_GUARD_BYTES);
+		return nullptr;
+	}
+
+	return mem;
+}
+
+void qcvm_unmapStack(void *mem, size_t bytes){
+	munmap(mem, bytes + QCVM_STACK_GUARD_BYTES);
+}
+
+static void qcvm_stackGuardHandler(int sig, siginfo_t *info, void *ctx){
+	const auto guard = qcvm_activeStackGuard;
+
+	if(guard && (guard->vm->frames.isGuard(info->si_addr) || guard->vm->localStack.isGuard(info->si_addr))){
+		// the jump doesn't restore the signal mask, so the next overflow could not be caught either
+		sigset_t segv;
+		sigemptyset(&segv);
+		sigaddset(&segv, SIGSEGV);
+		pthread_sigmask(SIG_UNBLOCK, &segv, nullptr);
+
+		siglongjmp(guard->jmp, 1);
+	}
+
+	// not ours, saved once before any host handler could chain back to this one
+	if(qcvm_prevSegvAction.sa_flags & SA_SIGINFO){
+		qcvm_prevSegvAction.sa_sigaction(sig, info, ctx);
+	}
+	else if(qcvm_prevSegvAction.sa_handler != SIG_DFL && qcvm_prevSegvAction.sa_handler != SIG_IGN){
+		qcvm_prevSegvAction.sa_handler(sig);
+	}
+	else{
+		// the faulting instruction is retried with the default action
+		std::signal(sig, SIG_DFL);
+	}
+}
+
+// checked every time a VM reserves its stacks, in case the host replaced the handler since
+bool qcvm_installStackGuard(){
+	static std::mutex installMut;
+	static bool installed = false;
+
+	std::scoped_lock lock(installMut);
+
+	struct sigaction current;
+	if(sigaction(SIGSEGV, nullptr, &current) != 0){
+		qcLogError("failed to query the signal handler for stack guards");
+		return false;
+	}
+	else if((current.sa_flags & SA_SIGINFO) && current.sa_sigaction == qcvm_stackGuardHandler){
+		return true;
+	}
+
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+
+	action.sa_sigaction = qcvm_stackGuardHandler;
+	action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+	sigemptyset(&action.sa_mask);
+
+	if(sigaction(SIGSEGV, &action, nullptr) != 0){
+		qcLogError("failed to install stack guard signal handler");
+		return false;
+	}
+
+	// only the action from before the first install is chained to, anything set after that may chain back to us
+	if(!installed){
+		qcvm_prevSegvAction = current;
+		installed = true;
+	}
+	else if(
+		(current.sa_flags & SA_SIGINFO) == (qcvm_prevSegvAction.sa_flags & SA_SIGINFO)
+		&& ((current.sa_flags & SA_SIGINFO) ? current.sa_sigaction == qcvm_prevSegvAction.sa_sigaction : current.sa_handler == qcvm_prevSegvAction.sa_handler)
+	){
+		// the previous handler was set again on top of ours
+		std::memset(&qcvm_prevSegvAction, 0, sizeof(qcvm_prevSegvAction));
+		qcvm_prevSegvAction.sa_handler = SIG_DFL;
+	}
+
+	return true;
+}
+
+#else // !QCVM_STACK_GUARD_PAGES
+
+#include <cstdlib>
+
+void *qcvm_mapStack(size_t bytes){
+	const auto mem = std::aligned_alloc(qcPageSize(), bytes);
+	if(!mem){
+		qcLogError("failed to allocate %zu bytes for stack", bytes);
+	}
+
+	return mem;
+}
+
+void qcvm_unmapStack(void *mem, size_t){
+	std::free(mem);
+}
+
+#endif // QCVM_STACK_GUARD_PAGES
@@ -72,7 +72,7 @@ static inline QC_Uint32 qcvm_tryCreateStr(
 			continue;
 		}
 
-		lastTaken = it.base();
+		lastTaken = std::next(it).base();
 		break;
 	}
 
@@ -1,45 +1,17 @@
 #define QCVM_IMPLEMENTATION
 
-#include "qcvm/vm.h"
-#include "qcvm/string.h"
+#include "qcvm/vm_impl.hpp"
 #include "qcvm/hash.hpp"
-
-#include "parallel_hashmap/phmap_fwd_decl.h"
-#include "parallel_hashmap/phmap.h"
-#include "parallel_hashmap/btree.h"
-
-#include "plf_colony.h"
+#include "qcvm/fastmath.hpp"
 
 #include "fmt/format.h"
 
 #include <vector>
+#include <algorithm>
 #include <charconv>
 
 using namespace qcvm::hash_literals;
 
-template<
-	class Key, class Value,
-	class Hash  = phmap::priv::hash_default_hash<Key>,
-	class Eq    = phmap::priv::hash_default_eq<Key>,
-	class Alloc = phmap::priv::Allocator<phmap::priv::Pair<const Key, Value>>
->
-using NodeHashMap = phmap::node_hash_map<Key, Value, Hash, Eq, Alloc>;
-
-template<
-	class Key, class Value,
-	class Hash  = phmap::priv::hash_default_hash<Key>,
-	class Eq    = phmap::priv::hash_default_eq<Key>,
-	class Alloc = phmap::priv::Allocator<phmap::priv::Pair<const Key, Value>>
->
-using FlatHashMap = phmap::flat_hash_map<Key, Value, Hash, Eq, Alloc>;
-
-template<
-    class Key, class Value,
-	class Compare = phmap::Less<Key>,
-	class Alloc   = phmap::Allocator<phmap::priv::Pair<const Key, Value>>
->
-using FlatMap = phmap::btree_map<Key, Value, Compare, Alloc>;
-
 extern "C" {
 
 bool qcMakeNativeFn(
@@ -69,7 +41,7 @@ bool qcMakeNativeFn(
 		}
 	}
 
-	ret->QCVM_SUPER_MEMBER = QC_VM_Fn{ .type = QC_VM_FN_NATIVE };
+	ret->QCVM_SUPER_MEMBER = QC_VM_Fn{ .type = QC_VM_FN_NATIVE, .nameIdx = 0, .flags = 0 };
 	ret->retType = retType;
 	ret->nParams = nParams;
 	std::memcpy(ret->paramTypes, paramTypes, sizeof(QC_ByteCodeType) * nParams);
@@ -77,47 +49,9 @@ bool qcMakeNativeFn(
 	return true;
 }
 
-union QC_VM_FnStorage{
-	QC_VM_Fn base;
-	QC_VM_Fn_Bytecode bytecode;
-	QC_VM_Fn_Native native;
-	QC_VM_Fn_Builtin builtin;
-};
-
-struct QC_VM_Entity{
-	FlatHashMap<
-	    std::string, QC_Value,
-		phmap::priv::hash_default_hash<std::string_view>,
-		phmap::priv::hash_default_eq<std::string_view>
-	> fields;
-};
-
-struct QC_VM{
-	const QC_Allocator *allocator;
-	QC_DefaultBuiltins vmBuiltins;
-	QC_StringBuffer *strBuf;
-
-	std::vector<const QC_ByteCode*> loadedBc;
-
-	FlatMap<QC_Uint32, QC_VM_Fn_Builtin> builtins;
-
-	FlatHashMap<
-		std::string, QC_VM_Value,
-		phmap::priv::hash_default_hash<std::string_view>,
-		phmap::priv::hash_default_eq<std::string_view>
-	> globals;
-
-	NodeHashMap<
-		std::string, QC_VM_FnStorage,
-		phmap::priv::hash_default_hash<std::string_view>,
-		phmap::priv::hash_default_eq<std::string_view>
-	> fns;
-
-	plf::colony<QC_VM_Entity> ents;
-};
-
 static bool qcVMSetBuiltin_unsafe(QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native fn, bool overrideExisting);
 static void qcVMResetDefaultBuiltins_unsafe(QC_VM *vm);
+static void qcvm_refreshFnHandles(QC_VM *vm);
 
 QC_VM *qcCreateVMA(const QC_Allocator *allocator, QC_Uint32 flags){
 	const auto mem = qcAllocA(allocator, sizeof(QC_VM), alignof(QC_VM));
@@ -129,10 +63,20 @@ QC_VM *qcCreateVMA(const QC_Allocator *allocator, QC_Uint32 flags){
 	const auto p = new(mem) QC_VM;
 
 	p->allocator = allocator;
+	p->fastMath = flags & QC_VM_CREATE_FAST_MATH;
+	p->checkPointers = !(flags & QC_VM_CREATE_UNCHECKED_POINTERS);
+	p->ents.soa = flags & QC_VM_CREATE_ENTITY_SOA;
 	p->strBuf = qcCreateStringBufferA(allocator);
+	p->globalMem.resize(QCVM_NUM_RESERVED_GLOBALS + QCVM_GLOBAL_PADDING);
+	p->builtinTable.store(new QC_VM_BuiltinTable);
 
 	p->vmBuiltins = QC_DefaultBuiltins{
-		.normalize = [](QC_VM*, QC_Vector v) -> QC_Vector{
+		.normalize = [](QC_VM *vm, QC_Vector v) -> QC_Vector{
+			if(vm->fastMath){
+				const auto s = qcvm::fastRsqrt(qcvm::fastDot3(v.x, v.y, v.z, v.x, v.y, v.z));
+				return QC_Vector{ v.x * s, v.y * s, v.z * s };
+			}
+
 			const auto vec = qcVec4(v.x, v.y, v.z, 0.f);
 			const auto norm = qcVec4Normalize(vec);
 			return QC_Vector{QC_VEC4_X(norm), QC_VEC4_Y(norm), QC_VEC4_Z(norm)};
@@ -141,6 +85,8 @@ QC_VM *qcCreateVMA(const QC_Allocator *allocator, QC_Uint32 flags){
 			const auto vec = qcVec4(v.x, v.y, v.z, 0.f);
 			return qcVec4Length(vec);
 		},
+		.find = qcvm_find,
+		.findradius = qcvm_findRadius,
 		.ftos = [](QC_VM *vm, QC_Float v) -> QC_String{
 			const auto str = std::to_string(v);
 			return qcStringBufferEmplace(vm->strBuf, QC_StrView{ str.c_str(), str.size() });
@@ -166,6 +112,7 @@ QC_VM *qcCreateVMA(const QC_Allocator *allocator, QC_Uint32 flags){
 		.floor = [](QC_VM*, QC_Float v) -> QC_Float{ return std::floor(v); },
 		.ceil = [](QC_VM*, QC_Float v) -> QC_Float{ return std::ceil(v); },
 		.fabs = [](QC_VM*, QC_Float v) -> QC_Float{ return std::abs(v); },
+		.nextent = qcvm_nextEnt,
 		.stof = [](QC_VM *vm, QC_String s) -> QC_Float{
 			const auto str = qcString(vm->strBuf, s);
 
@@ -192,6 +139,11 @@ bool qcDestroyVM(QC_VM *vm){
 
 	qcDestroyStringBuffer(vm->strBuf);
 
+	delete vm->builtinTable.load();
+	for(const auto &retired : vm->retiredBuiltins){
+		delete retired.table;
+	}
+
 	const auto allocator = vm->allocator;
 
 	std::destroy_at(vm);
@@ -219,24 +171,55 @@ static inline void qcVMResetDefaultBuiltins_unsafe(QC_VM *vm){
 
 		switch(qcvm::hash(builtinName)){
 
-#define QCVM_CASE_1(fn, retTy, argT) \
+#define QCVM_CASE_1(fn, retTy, argT, fnFlags) \
                 case #fn##_hash: \
                     newNative->ptr = [](QC_VM *vm, void*, void **args) -> QC_Value{ \
                         const auto arg = reinterpret_cast<const argT*>(args[0]); \
                         return QC_Value{ .retTy = vm->vmBuiltins.fn(vm, *arg) }; \
                     }; \
+					newFn->flags = (fnFlags); \
+					break;
+
+			QCVM_CASE_1(normalize,	v32, QC_Vector,	QC_FUNCTION_PURE)
+			QCVM_CASE_1(vlen,		f32, QC_Vector,	QC_FUNCTION_PURE)
+			QCVM_CASE_1(ftos,		u32, QC_Float,	0)
+			QCVM_CASE_1(vtos,		u32, QC_Vector,	0)
+			QCVM_CASE_1(rint,		f32, QC_Float,	QC_FUNCTION_PURE)
+			QCVM_CASE_1(floor,		f32, QC_Float,	QC_FUNCTION_PURE)
+			QCVM_CASE_1(ceil,		f32, QC_Float,	QC_FUNCTION_PURE)
+			QCVM_CASE_1(fabs,		f32, QC_Float,	QC_FUNCTION_PURE)
+			QCVM_CASE_1(stof,		f32, QC_String,	0)
+
+// entities are passed to bytecode by index
+#define QCVM_CASE_2_ENT(fn, argT0, argT1, fnFlags) \
+                case #fn##_hash: \
+                    newNative->ptr = [](QC_VM *vm, void*, void **args) -> QC_Value{ \
+                        const auto arg0 = reinterpret_cast<const argT0*>(args[0]); \
+                        const auto arg1 = reinterpret_cast<const argT1*>(args[1]); \
+                        return QC_Value{ .u32 = qcEntityIndex(vm->vmBuiltins.fn(vm, *arg0, *arg1)) }; \
+                    }; \
+					newFn->flags = (fnFlags); \
 					break;
 
-			QCVM_CASE_1(normalize,	v32, QC_Vector)
-			QCVM_CASE_1(vlen,		f32, QC_Vector)
-			QCVM_CASE_1(ftos,		u32, QC_Float)
-			QCVM_CASE_1(vtos,		u32, QC_Vector)
-			QCVM_CASE_1(rint,		f32, QC_Float)
-			QCVM_CASE_1(floor,		f32, QC_Float)
-			QCVM_CASE_1(ceil,		f32, QC_Float)
-			QCVM_CASE_1(fabs,		f32, QC_Float)
-			QCVM_CASE_1(stof,		f32, QC_String)
+			QCVM_CASE_2_ENT(findradius, QC_Vector, QC_Float, 0)
 
+			case "nextent"_hash:
+				newNative->ptr = [](QC_VM *vm, void*, void **args) -> QC_Value{
+					const auto ent = *reinterpret_cast<const QC_Uint32*>(args[0]);
+					return QC_Value{ .u32 = qcEntityIndex(vm->vmBuiltins.nextent(vm, ent)) };
+				};
+				break;
+
+			case "find"_hash:
+				newNative->ptr = [](QC_VM *vm, void*, void **args) -> QC_Value{
+					const auto start = *reinterpret_cast<const QC_Uint32*>(args[0]);
+					const auto field = *reinterpret_cast<const QC_Uint32*>(args[1]);
+					const auto match = *reinterpret_cast<const QC_String*>(args[2]);
+					return QC_Value{ .u32 = qcEntityIndex(vm->vmBuiltins.find(vm, start, field, match)) };
+				};
+				break;
+
+#undef QCVM_CASE_2_ENT
 #undef QCVM_CASE_1
 
 			default: break;
@@ -269,6 +252,30 @@ bool qcVMResetDefaultBuiltins(QC_VM *vm){
 	return true;
 }
 
+/**
+ * Replace the builtin table, must be called with builtinMut held.
+ * The old table is retired and freed once the executing thread can no longer be reading it.
+ */
+static void qcvm_publishBuiltins(QC_VM *vm, const QC_VM_BuiltinTable *table){
+	const auto oldTable = vm->builtinTable.exchange(table);
+	vm->retiredBuiltins.emplace_back(QC_VM_RetiredBuiltins{ .table = oldTable, .epoch = vm->builtinEpoch.fetch_add(1) });
+	vm->memoStale.store(true, std::memory_order_release);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// a reader that pinned a later epoch has already seen the new table
+	const auto pinnedEpoch = vm->builtinReaderEpoch.load();
+
+	std::erase_if(vm->retiredBuiltins, [pinnedEpoch](const QC_VM_RetiredBuiltins &retired){
+		if(pinnedEpoch != 0 && retired.epoch >= pinnedEpoch){
+			return false;
+		}
+
+		delete retired.table;
+		return true;
+	});
+}
+
 static inline bool qcVMSetBuiltin_unsafe(QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native fn, bool overrideExisting){
 	QCVM_SUPER(&fn)->type = QC_VM_FN_BUILTIN;
 
@@ -277,29 +284,46 @@ static inline bool qcVMSetBuiltin_unsafe(QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Na
 		.index = index
 	};
 
-	const auto setIfNamed = [vm, &fn, &newBuiltin]{
-		if(QCVM_SUPER(&fn)->nameIdx == 0){
-			return;
-		}
+	std::scoped_lock lock(vm->builtinMut);
+
+	const auto oldTable = vm->builtinTable.load(std::memory_order_relaxed);
+	if(index < oldTable->fns.size() && QCVM_SUPER(&oldTable->fns[index])->ptr && !overrideExisting){
+		return false;
+	}
 
+	std::string_view name;
+	bool bindName = false;
+
+	if(QCVM_SUPER(&fn)->nameIdx != 0){
 		const auto str = qcString(vm->strBuf, QCVM_SUPER(&fn)->nameIdx);
+		name = std::string_view(str.ptr, str.len);
 
-		vm->fns[std::string_view(str.ptr, str.len)] = QC_VM_FnStorage{ .builtin = newBuiltin };
-	};
+		// a name already bound to this index resolves through the table like every call does
+		const auto bound = vm->fns.find(name);
+		bindName = !bound || bound->base.type != QC_VM_FN_BUILTIN || bound->builtin.index != index;
 
-	const auto emplaceRes = vm->builtins.try_emplace(index, newBuiltin);
-	if(emplaceRes.second){
-		setIfNamed();
-		return true;
+		if(bindName && qcvm_isRunning(vm)){
+			qcLogError("can not bind name '%.*s' to builtin %u while the VM is running", int(name.size()), name.data(), index);
+			return false;
+		}
 	}
-	else if(overrideExisting){
-		emplaceRes.first->second = newBuiltin;
-		setIfNamed();
-		return true;
+
+	// copy on write, running scripts keep using the old table until their next call
+	const auto newTable = new QC_VM_BuiltinTable(*oldTable);
+	if(index >= newTable->fns.size()){
+		newTable->fns.resize(index + 1, QC_VM_Fn_Builtin{});
 	}
-	else{
-		return false;
+
+	newTable->fns[index] = newBuiltin;
+	qcvm_publishBuiltins(vm, newTable);
+
+	if(bindName){
+		// host names may not outlive the VM
+		*vm->fns.tryEmplace(name, true).first = QC_VM_FnStorage{ .builtin = newBuiltin };
+		qcvm_refreshFnHandles(vm);
 	}
+
+	return true;
 }
 
 bool qcVMSetBuiltin(QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native fn, bool overrideExisting){
@@ -311,6 +335,10 @@ bool qcVMSetBuiltin(QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native fn, bool overrid
 		qcLogError("NULL function passed for builtin %u", index);
 		return false;
 	}
+	else if(index >= QCVM_MAX_BUILTINS){
+		qcLogError("builtin index %u out of range (max %u)", index, QCVM_MAX_BUILTINS - 1);
+		return false;
+	}
 	else if(fn.nParams > 8){
 		qcLogError("invalid number of function parameters %u (max 8) for builtin %u", fn.nParams, index);
 		return false;
@@ -341,12 +369,15 @@ bool qcVMGetBuiltin(const QC_VM *vm, QC_Uint32 index, QC_VM_Fn_Native *ret){
 		return false;
 	}
 
-	const auto res = vm->builtins.find(index);
-	if(res == vm->builtins.end()){
+	// callable from any thread, the lock keeps the table from being retired under us
+	std::scoped_lock lock(const_cast<QC_VM*>(vm)->builtinMut);
+
+	const auto res = qcvm_findBuiltin(vm, index);
+	if(!res){
 		return false;
 	}
 
-	*ret = *QCVM_SUPER(&res->second);
+	*ret = *QCVM_SUPER(res);
 	return true;
 }
 
@@ -372,11 +403,257 @@ const QC_VM_Fn *qcVMFindFn(const QC_VM *vm, const char *name, size_t nameLen){
 
 	const auto nameStr = std::string_view(name, nameLen);
 	const auto res = vm->fns.find(nameStr);
-	if(res == vm->fns.end()){
+	if(!res){
 		return nullptr;
 	}
 
-	return &res->second.base;
+	return &res->base;
+}
+
+bool qcVMSetFnFlags(QC_VM *vm, const char *name, size_t nameLen, QC_Uint32 flags){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+	else if(qcvm_isRunning(vm)){
+		qcLogError("can not set flags of '%.*s' while the VM is running", int(nameLen), name);
+		return false;
+	}
+
+	const auto nameStr = std::string_view(name, nameLen);
+	const auto fn = vm->fns.find(nameStr);
+	if(!fn){
+		qcLogError("function '%.*s' not found", int(nameLen), name);
+		return false;
+	}
+
+	fn->base.flags = flags;
+
+	if(fn->base.type == QC_VM_FN_BUILTIN){
+		std::scoped_lock lock(vm->builtinMut);
+
+		const auto oldTable = vm->builtinTable.load(std::memory_order_relaxed);
+		if(fn->builtin.index < oldTable->fns.size()){
+			const auto newTable = new QC_VM_BuiltinTable(*oldTable);
+			QCVM_SUPER2(&newTable->fns[fn->builtin.index])->flags = flags;
+			qcvm_publishBuiltins(vm, newTable);
+		}
+	}
+	else if(fn->base.type == QC_VM_FN_BYTECODE){
+		for(auto &linkedFn : vm->fnTable){
+			if(linkedFn.fn.base.type == QC_VM_FN_BYTECODE && linkedFn.fn.bytecode.fn == fn->bytecode.fn){
+				linkedFn.fn.base.flags = flags;
+				linkedFn.inferredPure = false;
+			}
+		}
+	}
+
+	vm->memo.clear();
+	qcvm_refreshFnHandles(vm);
+	return true;
+}
+
+bool qcVMSetMemoCapacity(QC_VM *vm, QC_Uintptr maxEntries){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	vm->memoCapacity = maxEntries;
+
+	if(vm->memo.size() > maxEntries){
+		vm->memo.clear();
+	}
+
+	return true;
+}
+
+bool qcVMClearMemo(QC_VM *vm){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	vm->memo.clear();
+	return true;
+}
+
+static inline void qcvm_readGlobal(const QC_VM *vm, const QC_VM_Global *global, QC_VM_Value *ret){
+	ret->type = global->type;
+	std::memset(&ret->value, 0, sizeof(ret->value));
+	std::memcpy(&ret->value, vm->globalMem.data() + global->slot, qcvm_typeSlots(global->type) * sizeof(QC_VM_Slot));
+}
+
+static inline void qcvm_writeGlobal(QC_VM *vm, const QC_VM_Global *global, const QC_VM_Value *value){
+	std::memcpy(vm->globalMem.data() + global->slot, &value->value, qcvm_typeSlots(global->type) * sizeof(QC_VM_Slot));
+
+	// pure functions may have read the old value
+	vm->memo.clear();
+}
+
+bool qcVMGetGlobal(const QC_VM *vm, const char *name, size_t nameLen, QC_VM_Value *ret){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+	else if(!ret){
+		qcLogError("NULL ret argument passed");
+		return false;
+	}
+
+	const auto res = vm->globals.find(std::string_view(name, nameLen));
+	if(!res){
+		return false;
+	}
+
+	qcvm_readGlobal(vm, res, ret);
+	return true;
+}
+
+bool qcVMSetGlobal(QC_VM *vm, const char *name, size_t nameLen, QC_VM_Value value){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+
+	const auto res = vm->globals.find(std::string_view(name, nameLen));
+	if(!res){
+		qcLogError("global '%.*s' not found", int(nameLen), name);
+		return false;
+	}
+
+	const auto global = res;
+
+	if(value.type != global->type){
+		qcLogError("wrong type 0x%x for global '%.*s' (expected 0x%x)", value.type, int(nameLen), name, global->type);
+		return false;
+	}
+
+	qcvm_writeGlobal(vm, global, &value);
+	return true;
+}
+
+bool qcVMGlobalHandle(QC_VM *vm, const char *name, size_t nameLen, QC_VM_GlobalHandle *ret){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+	else if(!ret){
+		qcLogError("NULL ret argument passed");
+		return false;
+	}
+
+	const auto res = vm->globals.find(std::string_view(name, nameLen));
+	if(!res){
+		return false;
+	}
+
+	// linked slots never move, so global handles stay valid across loads
+	*ret = QC_VM_GlobalHandle(vm->globalHandles.size());
+	vm->globalHandles.emplace_back(*res);
+	return true;
+}
+
+bool qcVMGetGlobalH(const QC_VM *vm, QC_VM_GlobalHandle handle, QC_VM_Value *ret){
+	if(!vm || !ret){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+	else if(handle >= vm->globalHandles.size()){
+		qcLogError("invalid global handle %u", handle);
+		return false;
+	}
+
+	qcvm_readGlobal(vm, &vm->globalHandles[handle], ret);
+	return true;
+}
+
+bool qcVMSetGlobalH(QC_VM *vm, QC_VM_GlobalHandle handle, QC_VM_Value value){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(handle >= vm->globalHandles.size()){
+		qcLogError("invalid global handle %u", handle);
+		return false;
+	}
+
+	const auto global = &vm->globalHandles[handle];
+
+	if(value.type != global->type){
+		qcLogError("wrong type 0x%x for global handle %u (expected 0x%x)", value.type, handle, global->type);
+		return false;
+	}
+
+	qcvm_writeGlobal(vm, global, &value);
+	return true;
+}
+
+static void qcvm_resolveFnHandle(const QC_VM *vm, QC_VM_FnHandleEntry *entry){
+	const auto res = vm->fns.find(entry->name);
+	if(!res){
+		std::memset(&entry->fn, 0, sizeof(entry->fn));
+		entry->fnIdx = UINT32_MAX;
+		entry->found = false;
+		return;
+	}
+
+	entry->fn = *res;
+	entry->found = true;
+
+	if(entry->fn.base.type != QC_VM_FN_BYTECODE || !qcvm_linkedFnIndex(vm, &entry->fn.bytecode, &entry->fnIdx)){
+		entry->fnIdx = UINT32_MAX;
+	}
+}
+
+// called whenever a function name could resolve differently
+static void qcvm_refreshFnHandles(QC_VM *vm){
+	for(auto &entry : vm->fnHandles){
+		qcvm_resolveFnHandle(vm, &entry);
+	}
+}
+
+bool qcVMFnHandle(QC_VM *vm, const char *name, size_t nameLen, QC_VM_FnHandle *ret){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(!name || !nameLen){
+		qcLogError("invalid name string");
+		return false;
+	}
+	else if(!ret){
+		qcLogError("NULL ret argument passed");
+		return false;
+	}
+
+	QC_VM_FnHandleEntry entry;
+	entry.name = std::string(name, nameLen);
+	qcvm_resolveFnHandle(vm, &entry);
+
+	if(!entry.found){
+		return false;
+	}
+
+	*ret = QC_VM_FnHandle(vm->fnHandles.size());
+	vm->fnHandles.emplace_back(std::move(entry));
+	return true;
 }
 
 bool qcVMExecNative_unsafe(QC_VM *vm, const QC_VM_Fn_Native *fn, QC_Uint32 nargs, QC_Value *args, QC_Value *ret){
@@ -400,6 +677,135 @@ bool qcVMExecNative_unsafe(QC_VM *vm, const QC_VM_Fn_Native *fn, QC_Uint32 nargs
 	return true;
 }
 
+// fnIdx is the linked index of bytecode functions
+static inline bool qcVMExec_unsafe(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 fnIdx, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret){
+	switch(fn->type){
+		case QC_VM_FN_BUILTIN:{
+			// always calls the current definition, whatever the caller looked up
+			QC_VM_BuiltinReader builtinReader(vm);
+
+			const auto index = reinterpret_cast<const QC_VM_Fn_Builtin*>(fn)->index;
+			const auto builtinFn = qcvm_findBuiltin(vm, index);
+			if(!builtinFn){
+				qcLogError("builtin %u is not set", index);
+				return false;
+			}
+			else if(nArgs != QCVM_SUPER(builtinFn)->nParams){
+				qcLogError("wrong number of arguments passed: %u (expected %u)", nArgs, QCVM_SUPER(builtinFn)->nParams);
+				return false;
+			}
+
+			return qcVMExecNative_unsafe(vm, QCVM_SUPER(builtinFn), nArgs, args, ret);
+		}
+
+		case QC_VM_FN_NATIVE:{
+			const auto nativeFn = reinterpret_cast<const QC_VM_Fn_Native*>(fn);
+			if(nArgs != nativeFn->nParams){
+				qcLogError("wrong number of arguments passed: %u (expected %u)", nArgs, nativeFn->nParams);
+				return false;
+			}
+
+			return qcVMExecNative_unsafe(vm, nativeFn, nArgs, args, ret);
+		}
+
+		case QC_VM_FN_BYTECODE: return qcvm_execLinked(vm, fnIdx, nArgs, args, ret);
+
+		default:{
+			qcLogError("unimplemented QC_VM_FnType 0x%ux", fn->type);
+			return false;
+		}
+	}
+}
+
+static inline void qcvmMemoKey(const QC_VM_Fn *fn, QC_Uint32 nArgs, const QC_Value *args, QC_VM_MemoKey *ret){
+	ret->nSlots = 0;
+
+	const auto pushSlots = [ret](const QC_Uint32 *slots, QC_Uint32 n){
+		std::memcpy(ret->slots + ret->nSlots, slots, n * sizeof(QC_Uint32));
+		ret->nSlots += n;
+	};
+
+	if(fn->type == QC_VM_FN_BYTECODE){
+		const auto bcFn = reinterpret_cast<const QC_VM_Fn_Bytecode*>(fn);
+		ret->ids[0] = bcFn->fn;
+		ret->ids[1] = nullptr;
+
+		for(QC_Uint32 i = 0; i < nArgs; i++){
+			const auto argSize = QC_Uint32(QC_MIN(QC_MAX(bcFn->fn->argSizes[i], 1), 3));
+			QC_Uint32 slots[3];
+			std::memcpy(slots, &args[i], argSize * sizeof(QC_Uint32));
+			pushSlots(slots, argSize);
+		}
+	}
+	else{
+		const auto nativeFn = reinterpret_cast<const QC_VM_Fn_Native*>(fn);
+		ret->ids[0] = reinterpret_cast<const void*>(nativeFn->ptr);
+		ret->ids[1] = nativeFn->user;
+
+		for(QC_Uint32 i = 0; i < nArgs; i++){
+			QC_Uint32 slots[3];
+
+			switch(nativeFn->paramTypes[i]){
+				case QC_BYTECODE_TYPE_VECTOR:{
+					std::memcpy(slots, &args[i].v32, sizeof(QC_Vector));
+					pushSlots(slots, 3);
+					break;
+				}
+
+				case QC_BYTECODE_TYPE_INT64:
+				case QC_BYTECODE_TYPE_UINT64:
+				case QC_BYTECODE_TYPE_DOUBLE:{
+					std::memcpy(slots, &args[i].u64, sizeof(QC_Uint64));
+					pushSlots(slots, 2);
+					break;
+				}
+
+				default:{
+					pushSlots(&args[i].u32, 1);
+					break;
+				}
+			}
+		}
+	}
+}
+
+bool qcvm_exec(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 fnIdx, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret){
+	QC_Value unused;
+	if(!ret){
+		ret = &unused;
+	}
+
+	if(!(fn->flags & QC_FUNCTION_PURE) || !vm->memoCapacity){
+		return qcVMExec_unsafe(vm, fn, fnIdx, nArgs, args, ret);
+	}
+
+	// pure bytecode may have called a builtin that was since replaced
+	if(vm->memoStale.load(std::memory_order_relaxed) && vm->memoStale.exchange(false, std::memory_order_acquire)){
+		vm->memo.clear();
+	}
+
+	QC_VM_MemoKey key;
+	qcvmMemoKey(fn, nArgs, args, &key);
+
+	const auto res = vm->memo.find(key);
+	if(res != vm->memo.end()){
+		*ret = res->second;
+		return true;
+	}
+
+	if(!qcVMExec_unsafe(vm, fn, fnIdx, nArgs, args, ret)){
+		return false;
+	}
+
+	// bounded by dropping everything; pure results are cheap to recompute
+	if(vm->memo.size() >= vm->memoCapacity){
+		vm->memo.clear();
+	}
+
+	vm->memo.emplace(key, *ret);
+	return true;
+}
+
 bool qcVMExec(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret){
 	if(!vm){
 		qcLogError("NULL vm passed to qcVMExec");
@@ -414,28 +820,165 @@ bool qcVMExec(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 nArgs, QC_Value *args, QC
 		return false;
 	}
 
-	if(!ret){
-		static QC_Value unused;
-		ret = &unused;
+	QC_Uint32 fnIdx = UINT32_MAX;
+
+	if(fn->type == QC_VM_FN_BYTECODE && !qcvm_linkedFnIndex(vm, reinterpret_cast<const QC_VM_Fn_Bytecode*>(fn), &fnIdx)){
+		qcLogError("bytecode function has not been loaded into this VM");
+		return false;
 	}
 
-	switch(fn->type){
-		case QC_VM_FN_BUILTIN:
-		case QC_VM_FN_NATIVE:{
-			const auto nativeFn = reinterpret_cast<const QC_VM_Fn_Native*>(fn);
-			if(nArgs != nativeFn->nParams){
-				qcLogError("wrong number of arguments passed: %u (expected %u)", nArgs, nativeFn->nParams);
+	return qcvm_exec(vm, fn, fnIdx, nArgs, args, ret);
+}
+
+bool qcVMExecH(QC_VM *vm, QC_VM_FnHandle handle, QC_Uint32 nArgs, QC_Value *args, QC_Value *ret){
+	if(!vm){
+		qcLogError("NULL vm passed to qcVMExecH");
+		return false;
+	}
+	else if(handle >= vm->fnHandles.size()){
+		qcLogError("invalid function handle %u", handle);
+		return false;
+	}
+	else if(nArgs > 8){
+		qcLogError("too many arguments passed: %u (max 8)", nArgs);
+		return false;
+	}
+
+	const auto entry = &vm->fnHandles[handle];
+
+	if(!entry->found){
+		qcLogError("function '%s' is no longer defined", entry->name.c_str());
+		return false;
+	}
+	else if(entry->fn.base.type == QC_VM_FN_BYTECODE && entry->fnIdx == UINT32_MAX){
+		qcLogError("bytecode function has not been loaded into this VM");
+		return false;
+	}
+
+	return qcvm_exec(vm, &entry->fn.base, entry->fnIdx, nArgs, args, ret);
+}
+
+bool qcVMSetProfiling(QC_VM *vm, bool enabled){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+
+	vm->profiling = enabled;
+
+	if(enabled){
+		vm->stmtProfile.resize(vm->code.size());
+		vm->globalProfile.resize(qcvm_numGlobals(vm));
+	}
+
+	return true;
+}
+
+const QC_VM_StmtProfile *qcVMStmtProfile(const QC_VM *vm, size_t *numStmtsRet){
+	if(!vm || !numStmtsRet){
+		qcLogError("NULL argument passed");
+		return nullptr;
+	}
+
+	*numStmtsRet = vm->stmtProfile.size();
+	return vm->stmtProfile.empty() ? nullptr : vm->stmtProfile.data();
+}
+
+bool qcVMSetStmtProfile(QC_VM *vm, const QC_VM_StmtProfile *profile, size_t numStmts){
+	if(!vm || !profile){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+	else if(numStmts != vm->code.size()){
+		qcLogError("profile has %zu statements, expected %zu", numStmts, vm->code.size());
+		return false;
+	}
+
+	vm->stmtProfile.assign(profile, profile + numStmts);
+	return true;
+}
+
+bool qcVMReorderBlocks(QC_VM *vm){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(vm->frames.size()){
+		qcLogError("can not reorder blocks during execution");
+		return false;
+	}
+
+	return qcvm_reorderBlocks(vm);
+}
+
+const QC_Uint64 *qcVMGlobalProfile(const QC_VM *vm, size_t *numGlobalsRet){
+	if(!vm || !numGlobalsRet){
+		qcLogError("NULL argument passed");
+		return nullptr;
+	}
+
+	*numGlobalsRet = vm->globalProfile.size();
+	return vm->globalProfile.empty() ? nullptr : vm->globalProfile.data();
+}
+
+bool qcVMSetGlobalProfile(QC_VM *vm, const QC_Uint64 *profile, size_t numGlobals){
+	if(!vm || !profile){
+		qcLogError("NULL argument passed");
+		return false;
+	}
+	else if(numGlobals != qcvm_numGlobals(vm)){
+		qcLogError("profile has %zu globals, expected %u", numGlobals, qcvm_numGlobals(vm));
+		return false;
+	}
+
+	vm->globalProfile.assign(profile, profile + numGlobals);
+	return true;
+}
+
+bool qcVMRelayoutGlobals(QC_VM *vm){
+	if(!vm){
+		qcLogError("NULL vm argument passed");
+		return false;
+	}
+	else if(vm->frames.size()){
+		qcLogError("can not move globals during execution");
+		return false;
+	}
+
+	return qcvm_relayoutGlobals(vm);
+}
+
+bool qcVMExecWide(QC_VM *vm, const QC_VM_Fn *fn, QC_Uint32 nLanes, QC_Uint32 nArgs, QC_Value *args, QC_Value *rets){
+	if(!vm){
+		qcLogError("NULL vm passed to qcVMExecWide");
+		return false;
+	}
+	else if(!fn){
+		qcLogError("NULL fn passed to qcVMExecWide");
+		return false;
+	}
+	else if(nArgs > 8){
+		qcLogError("too many arguments passed: %u (max 8)", nArgs);
+		return false;
+	}
+	else if(nLanes && (!rets || (nArgs && !args))){
+		qcLogError("NULL args or rets passed to qcVMExecWide");
+		return false;
+	}
+
+	QC_Uint32 fnIdx;
+
+	if(fn->type != QC_VM_FN_BYTECODE || !qcvm_linkedFnIndex(vm, reinterpret_cast<const QC_VM_Fn_Bytecode*>(fn), &fnIdx)){
+		for(QC_Uint32 l = 0; l < nLanes; l++){
+			if(!qcVMExec(vm, fn, nArgs, args + (l * nArgs), rets + l)){
 				return false;
 			}
-
-			return qcVMExecNative_unsafe(vm, nativeFn, nArgs, args, ret);
 		}
 
-		default:{
-			qcLogError("unimplemented QC_VM_FnType 0x%ux", fn->type);
-			return false;
-		}
+		return true;
 	}
+
+	return qcvm_execWide(vm, fnIdx, nLanes, nArgs, args, rets);
 }
 
 inline QC_String qcvmByteCodeStringEmplace(QC_StringBuffer *buf, const QC_ByteCode *bc, QC_String index){
@@ -444,40 +987,292 @@ inline QC_String qcvmByteCodeStringEmplace(QC_StringBuffer *buf, const QC_ByteCo
 	return qcStringBufferEmplace(buf, QC_StrView{ str.data(), str.size() });
 }
 
+enum QC_VM_StmtEffect{
+	QCVM_STMT_NONE,
+	QCVM_STMT_WRITES_B,
+	QCVM_STMT_WRITES_C,
+	QCVM_STMT_CALL,
+	QCVM_STMT_IMPURE,
+};
+
+static inline QC_VM_StmtEffect qcvm_stmtEffect(QC_Uint32 op){
+	switch(op){
+		case QC_OP_DONE:
+		case QC_OP_RETURN:
+		case QC_OP_GOTO:
+		case QC_OP_IF:
+		case QC_OP_IFNOT:
+		case QC_OP_IF_S:
+		case QC_OP_IFNOT_S:
+			return QCVM_STMT_NONE;
+
+		case QC_OP_MUL_F: case QC_OP_MUL_V: case QC_OP_MUL_FV: case QC_OP_MUL_VF:
+		case QC_OP_DIV_F: case QC_OP_ADD_F: case QC_OP_ADD_V: case QC_OP_SUB_F: case QC_OP_SUB_V:
+		case QC_OP_EQ_F: case QC_OP_EQ_V: case QC_OP_EQ_S: case QC_OP_EQ_E: case QC_OP_EQ_FNC:
+		case QC_OP_NE_F: case QC_OP_NE_V: case QC_OP_NE_S: case QC_OP_NE_E: case QC_OP_NE_FNC:
+		case QC_OP_LE: case QC_OP_GE: case QC_OP_LT: case QC_OP_GT:
+		case QC_OP_NOT_F: case QC_OP_NOT_V: case QC_OP_NOT_S: case QC_OP_NOT_ENT: case QC_OP_NOT_FNC:
+		case QC_OP_AND: case QC_OP_OR: case QC_OP_BITAND: case QC_OP_BITOR:
+		case QC_OP_ADD_I: case QC_OP_ADD_FI: case QC_OP_ADD_IF:
+		case QC_OP_SUB_I: case QC_OP_SUB_FI: case QC_OP_SUB_IF:
+		case QC_OP_CONV_ITOF: case QC_OP_CONV_FTOI:
+		case QC_OP_BITAND_I: case QC_OP_BITOR_I: case QC_OP_MUL_I: case QC_OP_DIV_I: case QC_OP_EQ_I: case QC_OP_NE_I:
+		case QC_OP_NOT_I: case QC_OP_DIV_VF: case QC_OP_BITXOR_I: case QC_OP_RSHIFT_I: case QC_OP_LSHIFT_I:
+			return QCVM_STMT_WRITES_C;
+
+		case QC_OP_STORE_F: case QC_OP_STORE_V: case QC_OP_STORE_S:
+		case QC_OP_STORE_ENT: case QC_OP_STORE_FLD: case QC_OP_STORE_FNC:
+		case QC_OP_STORE_I: case QC_OP_STORE_IF: case QC_OP_STORE_FI:
+		case QC_OP_MULSTORE_F: case QC_OP_MULSTORE_VF: case QC_OP_DIVSTORE_F:
+		case QC_OP_ADDSTORE_F: case QC_OP_ADDSTORE_V: case QC_OP_SUBSTORE_F: case QC_OP_SUBSTORE_V:
+		case QC_OP_BITSETSTORE_F: case QC_OP_BITCLRSTORE_F:
+			return QCVM_STMT_WRITES_B;
+
+		case QC_OP_CALL0: case QC_OP_CALL1: case QC_OP_CALL2: case QC_OP_CALL3: case QC_OP_CALL4:
+		case QC_OP_CALL5: case QC_OP_CALL6: case QC_OP_CALL7: case QC_OP_CALL8:
+		case QC_OP_CALL1H: case QC_OP_CALL2H: case QC_OP_CALL3H: case QC_OP_CALL4H:
+		case QC_OP_CALL5H: case QC_OP_CALL6H: case QC_OP_CALL7H: case QC_OP_CALL8H:
+			return QCVM_STMT_CALL;
+
+		// entity loads/stores, pointers, state and random ops all observe or change more than their operands
+		default: return QCVM_STMT_IMPURE;
+	}
+}
+
+/**
+ * Find linked functions that only write their own locals, only read globals never written by any loaded bytecode
+ * and only call other pure functions. Globals written by the host invalidate the memo instead.
+ */
+static void qcvm_inferPure(const QC_VM *vm, std::vector<bool> &pureRet){
+	const auto nLinked = QC_Uint32(vm->fnTable.size());
+
+	// every slot any module writes, by linked global
+	std::vector<bool> written(qcvm_numGlobals(vm), false);
+
+	for(const auto &mod : vm->modules){
+		const auto stmts = qcByteCodeStatements(mod.bc);
+		const auto nStmts = qcByteCodeNumStatements(mod.bc);
+		const auto nGlobals = QC_Uint32(mod.globalMap.size());
+
+		for(QC_Uintptr i = 0; i < nStmts; i++){
+			const auto stmt = stmts + i;
+			const auto effect = qcvm_stmtEffect(stmt->op);
+
+			// everything else that has a global c operand may write it, loads and ADDRESS included
+			QC_Uint32 dest;
+			if(effect == QCVM_STMT_NONE || effect == QCVM_STMT_CALL) continue;
+			else if(effect == QCVM_STMT_WRITES_B) dest = stmt->b;
+			else if(qcvm_opGlobalOperands(stmt->op) & 0x4) dest = stmt->c;
+			else continue;
+
+			// vector ops write 3 slots; over-marking only makes the analysis more conservative
+			for(QC_Uint32 j = dest; j < QC_MIN(dest + 3, nGlobals); j++){
+				written[mod.globalMap[j]] = true;
+			}
+		}
+	}
+
+	const auto moduleOf = [vm](QC_Uint32 linkedIdx) -> const QC_VM_Module*{
+		for(const auto &mod : vm->modules){
+			if(linkedIdx >= mod.fnBase && linkedIdx < mod.fnBase + qcByteCodeNumFunctions(mod.bc)){
+				return &mod;
+			}
+		}
+
+		return nullptr;
+	};
+
+	enum{ UNKNOWN, VISITING, PURE, IMPURE };
+	std::vector<QC_Uint8> state(nLinked, UNKNOWN);
+
+	const auto isPure = [&](auto &&self, QC_Uint32 linkedIdx) -> bool{
+		if(state[linkedIdx] != UNKNOWN){
+			// recursion is treated as impure
+			return state[linkedIdx] == PURE;
+		}
+
+		const auto &linkedFn = vm->fnTable[linkedIdx];
+
+		if(linkedFn.fn.base.type == QC_VM_FN_BUILTIN){
+			const auto res = qcvm_findBuiltin(vm, linkedFn.fn.builtin.index);
+			const bool pure = res && (QCVM_SUPER2(res)->flags & QC_FUNCTION_PURE);
+			state[linkedIdx] = pure ? PURE : IMPURE;
+			return pure;
+		}
+
+		QC_Uint32 ownIdx;
+		if(linkedFn.fn.base.type != QC_VM_FN_BYTECODE || !qcvm_linkedFnIndex(vm, &linkedFn.fn.bytecode, &ownIdx)){
+			state[linkedIdx] = IMPURE;
+			return false;
+		}
+		else if(ownIdx != linkedIdx){
+			// declared here, defined by another module
+			state[linkedIdx] = VISITING;
+			const bool pure = self(self, ownIdx);
+			state[linkedIdx] = pure ? PURE : IMPURE;
+			return pure;
+		}
+
+		state[linkedIdx] = VISITING;
+
+		const auto mod = moduleOf(linkedIdx);
+		const auto fn = linkedFn.fn.bytecode.fn;
+		const auto stmts = qcByteCodeStatements(mod->bc);
+		const auto nGlobals = QC_Uint32(mod->globalMap.size());
+
+		const auto endRes = std::upper_bound(mod->entries.begin(), mod->entries.end(), linkedFn.entry);
+		const auto end = (endRes == mod->entries.end() ? mod->stmtEnd : *endRes) - mod->stmtBase;
+
+		// module slots, locals are not shared so they never need mapping
+		const auto isLocal = [fn](QC_Uint32 slot){
+			return slot < QCVM_NUM_RESERVED_GLOBALS
+				|| (slot >= QC_Uint32(fn->localIdx) && slot < (fn->localIdx + fn->numLocals));
+		};
+
+		const auto readable = [&](QC_Uint32 slot){
+			return isLocal(slot) || (slot < nGlobals && !written[mod->globalMap[slot]]);
+		};
+
+		bool pure = true;
+
+		for(QC_Uintptr i = fn->entryPoint; pure && i < end; i++){
+			const auto stmt = stmts + i;
+
+			switch(qcvm_stmtEffect(stmt->op)){
+				case QCVM_STMT_NONE:{
+					pure = stmt->op == QC_OP_GOTO || readable(stmt->a);
+					break;
+				}
+
+				case QCVM_STMT_WRITES_B:{
+					pure = readable(stmt->a) && isLocal(stmt->b);
+					break;
+				}
+
+				case QCVM_STMT_WRITES_C:{
+					pure = readable(stmt->a) && readable(stmt->b) && isLocal(stmt->c);
+					break;
+				}
+
+				case QCVM_STMT_CALL:{
+					if(isLocal(stmt->a) || !readable(stmt->a)){
+						pure = false;
+						break;
+					}
+
+					// never written, so the callee is whatever the global was linked to
+					const auto calleeIdx = vm->globalMem[mod->globalMap[stmt->a]].u32;
+					pure = calleeIdx > 0 && calleeIdx < nLinked && self(self, calleeIdx);
+					break;
+				}
+
+				default:{
+					pure = false;
+					break;
+				}
+			}
+		}
+
+		state[linkedIdx] = pure ? PURE : IMPURE;
+		return pure;
+	};
+
+	pureRet.assign(nLinked, false);
+
+	for(QC_Uint32 i = 1; i < nLinked; i++){
+		pureRet[i] = isPure(isPure, i);
+	}
+}
+
+/**
+ * Re-infer every function of the modules loaded with QC_VM_LOAD_INFER_PURE.
+ * A later module may write a global an earlier pure function reads, so inferred flags are taken back as well.
+ */
+static void qcvm_applyInferredPure(QC_VM *vm){
+	std::vector<bool> pureFns;
+	qcvm_inferPure(vm, pureFns);
+
+	bool revoked = false;
+
+	for(const auto &mod : vm->modules){
+		if(!mod.inferPure) continue;
+
+		const auto fns = qcByteCodeFunctions(mod.bc);
+		const auto nFns = qcByteCodeNumFunctions(mod.bc);
+		const auto strBuf = qcByteCodeStrings(mod.bc);
+
+		for(QC_Uint32 i = 0; i < nFns; i++){
+			auto &linkedFn = vm->fnTable[mod.fnBase + i];
+			if(fns[i].entryPoint <= 0) continue;
+
+			auto &flags = linkedFn.fn.base.flags;
+
+			if(pureFns[mod.fnBase + i] && !(flags & QC_FUNCTION_PURE)){
+				flags |= QC_FUNCTION_PURE;
+				linkedFn.inferredPure = true;
+			}
+			else if(!pureFns[mod.fnBase + i] && linkedFn.inferredPure){
+				flags &= ~QC_FUNCTION_PURE;
+				linkedFn.inferredPure = false;
+				revoked = true;
+			}
+			else{
+				continue;
+			}
+
+			// other modules may hold a copy of the descriptor, and the host finds it by name
+			for(auto &other : vm->fnTable){
+				if(other.fn.base.type == QC_VM_FN_BYTECODE && other.fn.bytecode.fn == fns + i){
+					other.fn.base.flags = flags;
+					other.inferredPure = linkedFn.inferredPure;
+				}
+			}
+
+			const auto res = vm->fns.find(std::string_view(strBuf + fns[i].nameIdx));
+			if(res && res->base.type == QC_VM_FN_BYTECODE && res->bytecode.fn == fns + i){
+				res->base.flags = flags;
+			}
+		}
+	}
+
+	if(revoked){
+		vm->memo.clear();
+	}
+}
+
 bool qcVMLoadByteCode(QC_VM *vm, const QC_ByteCode *bc, QC_Uint32 loadFlags){
 	if(!vm || !bc){
 		qcLogError("NULL argument passed");
 		return false;
 	}
 
+	QC_VM_BuiltinReader builtinReader(vm);
+
 	const auto strBuf = qcByteCodeStrings(bc);
-	const auto strBufLen = qcByteCodeStringsSize(bc);
 
 	const auto fns = qcByteCodeFunctions(bc);
 	const auto nFns = qcByteCodeNumFunctions(bc);
 
-	const auto defs = qcByteCodeDefs(bc);
-	const auto nDefs = qcByteCodeNumDefs(bc);
+	const auto fnBase = QC_Uint32(vm->fnTable.size());
 
-	const auto globals = qcByteCodeGlobals(bc);
-	const auto nGlobals = qcByteCodeNumGlobals(bc);
+	// only added once the module has linked, so a failed load leaves QC_VM::fns as it was
+	std::vector<std::pair<QC_Uint32, QC_VM_FnStorage>> newFns;
+	newFns.reserve(nFns);
 
 	for(QC_Uint32 i = 0; i < nFns; i++){
 		const auto fn = fns + i;
-		const auto fnName = std::string_view(strBuf + fn->nameIdx);
 
 		if(fn->entryPoint < 0){
 			const auto builtinIndex = QC_Uint32(-fn->entryPoint);
-			const auto res = vm->builtins.find(builtinIndex);
-			if(res == vm->builtins.end()){
+			const auto builtinFn = qcvm_findBuiltin(vm, builtinIndex);
+			if(!builtinFn){
 				qcLogError("builtin %u not found for function '%s'", builtinIndex, strBuf + fn->nameIdx);
 				return false;
 			}
 
-			const auto builtinFn = &res->second;
 			const auto nativeFn = QCVM_SUPER(builtinFn);
 
-			if(fn->numArgs != nativeFn->nParams){
+			if(QC_Uint32(fn->numArgs) != nativeFn->nParams){
 				qcLogError(
 					"wrong number of parameters for builtin (%u) function '%s': %u (should be %u)",
 					builtinIndex, strBuf + fn->nameIdx, fn->numArgs, nativeFn->nParams
@@ -489,61 +1284,72 @@ bool qcVMLoadByteCode(QC_VM *vm, const QC_ByteCode *bc, QC_Uint32 loadFlags){
 				const auto builtinParamType = nativeFn->paramTypes[j];
 				const auto builtinParamSize = qcByteCodeTypeSize((QC_ByteCodeType) builtinParamType);
 				const auto fnParamSize = fn->argSizes[j];
-				if(fnParamSize != builtinParamSize){
+				if(QC_Uint32(fnParamSize) != builtinParamSize){
 					qcLogError(
 						"wrong argument size %u for argument %u in builtin %u for function '%s'",
 						fnParamSize, j, builtinIndex, strBuf + fn->nameIdx
 					);
 
-					return UINT32_MAX;
+					return false;
 				}
 			}
 
-			const auto emplaceRes = vm->fns.try_emplace(fnName);
-			if(emplaceRes.second || (loadFlags & QC_VM_LOAD_OVERRIDE_FNS)){
-				const auto vmFn = &emplaceRes.first->second;
-				vmFn->builtin = *builtinFn;
-				vmFn->base.nameIdx = qcvmByteCodeStringEmplace(vm->strBuf, bc, fn->nameIdx);
-			}
+			auto &newFn = newFns.emplace_back(i, QC_VM_FnStorage{}).second;
+			newFn.builtin = *builtinFn;
 		}
-		else{
-			const auto emplaceRes = vm->fns.try_emplace(fnName);
-			if(emplaceRes.second || (loadFlags & QC_VM_LOAD_OVERRIDE_FNS)){
-				const auto vmFn = &emplaceRes.first->second;
-				vmFn->bytecode = QC_VM_Fn_Bytecode{
-					.QCVM_SUPER_MEMBER = QC_VM_Fn{
-						.type = QC_VM_FN_BYTECODE,
-						.nameIdx = qcvmByteCodeStringEmplace(vm->strBuf, bc, fn->nameIdx)
-					},
-					.bc = bc,
-					.fn = fn
-				};
-			}
+		else if(fn->entryPoint > 0){
+			auto &newFn = newFns.emplace_back(i, QC_VM_FnStorage{}).second;
+			newFn.bytecode = QC_VM_Fn_Bytecode{
+				.QCVM_SUPER_MEMBER = QC_VM_Fn{ .type = QC_VM_FN_BYTECODE, .nameIdx = 0, .flags = 0 },
+				.bc = bc,
+				.fn = fn
+			};
 		}
 	}
 
-	for(QC_Uint32 i = 0; i < nDefs; i++){
-		const auto def = defs + i;
-		const bool isGlobal = def->type & (1u << 15u);
+	if(!qcvm_link(vm, bc, loadFlags)){
+		qcLogError("failed to link bytecode");
+		return false;
+	}
 
-		if(!isGlobal){
-			continue;
+	for(const auto &[fnIdx, newFn] : newFns){
+		const auto emplaceRes = vm->fns.tryEmplace(std::string_view(strBuf + fns[fnIdx].nameIdx));
+		if(emplaceRes.second || (loadFlags & QC_VM_LOAD_OVERRIDE_FNS)){
+			*emplaceRes.first = newFn;
+			emplaceRes.first->base.nameIdx = qcvmByteCodeStringEmplace(vm->strBuf, bc, fns[fnIdx].nameIdx);
 		}
+	}
 
-		const auto defType = def->type & ~(1u << 15u);
-		const auto defName = std::string_view(strBuf + def->nameIdx);
+	vm->modules.back().inferPure = (loadFlags & QC_VM_LOAD_INFER_PURE) != 0;
 
-		const auto globalVal = globals + def->globalIdx;
+	if(std::any_of(vm->modules.begin(), vm->modules.end(), [](const QC_VM_Module &mod){ return mod.inferPure; })){
+		qcvm_applyInferredPure(vm);
+	}
+
+	vm->globals.build();
+	vm->fns.build();
+	vm->fields.build();
 
-		const auto emplaceRes = vm->globals.try_emplace(defName);
-		if(emplaceRes.second || (loadFlags & QC_VM_LOAD_OVERRIDE_GLOBALS)){
-			const auto vmGlobal = &emplaceRes.first->second;
-			*vmGlobal = QC_VM_Value{ .type = defType, .value = *globalVal };
+	qcvm_resolveThinkDefs(vm);
+	qcvm_refreshFnHandles(vm);
+	return true;
+}
+
+bool qcVMWarmAll(QC_VM *vm){
+	if(!vm){
+		qcLogError("NULL vm passed to qcVMWarmAll");
+		return false;
+	}
+
+	bool res = true;
+
+	for(const auto &mod : vm->modules){
+		for(const auto entry : mod.entries){
+			res = qcvm_ensureFn(vm, entry) && res;
 		}
 	}
 
-	vm->loadedBc.emplace_back(bc);
-	return true;
+	return res;
 }
 
 }
@@ -0,0 +1,482 @@
+#define QCVM_IMPLEMENTATION
+
+#include "qcvm/vm_impl.hpp"
+
+#include <algorithm>
+
+#define QCVM_WIDE_LANES QC_VM_WIDE_LANES
+
+// branch-free masked store so the lane loop vectorizes
+template<typename Fn>
+static inline void qcvm_wideStore(const QC_Uint32 *laneMask, QC_VM_Slot *dst, Fn &&fn){
+	for(QC_Uint32 l = 0; l < QCVM_WIDE_LANES; l++){
+		const QC_VM_Slot val = fn(l);
+		dst[l].u32 = (val.u32 & laneMask[l]) | (dst[l].u32 & ~laneMask[l]);
+	}
+}
+
+extern "C" {
+
+static inline bool qcvm_wideSupported(QC_Uint32 op){
+	switch(op){
+		case QC_OP_DONE:
+		case QC_OP_RETURN:
+		case QC_OP_GOTO:
+		case QC_OP_IF:
+		case QC_OP_IFNOT:
+		case QC_OP_MUL_F:
+		case QC_OP_MUL_V:
+		case QC_OP_MUL_FV:
+		case QC_OP_MUL_VF:
+		case QC_OP_DIV_F:
+		case QC_OP_DIV_VF:
+		case QC_OP_ADD_F:
+		case QC_OP_ADD_V:
+		case QC_OP_SUB_F:
+		case QC_OP_SUB_V:
+		case QC_OP_EQ_F:
+		case QC_OP_EQ_V:
+		case QC_OP_EQ_E:
+		case QC_OP_EQ_FNC:
+		case QC_OP_NE_F:
+		case QC_OP_NE_V:
+		case QC_OP_NE_E:
+		case QC_OP_NE_FNC:
+		case QC_OP_LE:
+		case QC_OP_GE:
+		case QC_OP_LT:
+		case QC_OP_GT:
+		case QC_OP_STORE_F:
+		case QC_OP_STORE_V:
+		case QC_OP_STORE_S:
+		case QC_OP_STORE_ENT:
+		case QC_OP_STORE_FLD:
+		case QC_OP_STORE_FNC:
+		case QC_OP_STORE_I:
+		case QC_OP_NOT_F:
+		case QC_OP_NOT_V:
+		case QC_OP_NOT_ENT:
+		case QC_OP_NOT_FNC:
+		case QC_OP_AND:
+		case QC_OP_OR:
+		case QC_OP_BITAND:
+		case QC_OP_BITOR:
+		case QC_OP_ADD_I:
+		case QC_OP_SUB_I:
+		case QC_OP_MUL_I:
+		case QC_OP_EQ_I:
+		case QC_OP_NE_I:
+		case QC_OP_LE_I:
+		case QC_OP_GE_I:
+		case QC_OP_LT_I:
+		case QC_OP_GT_I:
+		case QC_OP_CONV_ITOF:
+		case QC_OP_CONV_FTOI:
+			return true;
+
+		default: return false;
+	}
+}
+
+// number of slots written through the destination operand
+static inline QC_Uint32 qcvm_wideDestSlots(QC_Uint32 op){
+	switch(op){
+		case QC_OP_DONE:
+		case QC_OP_RETURN:
+		case QC_OP_GOTO:
+		case QC_OP_IF:
+		case QC_OP_IFNOT:
+			return 0;
+
+		case QC_OP_MUL_FV:
+		case QC_OP_MUL_VF:
+		case QC_OP_DIV_VF:
+		case QC_OP_ADD_V:
+		case QC_OP_SUB_V:
+		case QC_OP_STORE_V:
+			return 3;
+
+		default: return 1;
+	}
+}
+
+static inline bool qcvm_wideDestIsB(QC_Uint32 op){
+	return (op >= QC_OP_STORE_F && op <= QC_OP_STORE_FNC) || op == QC_OP_STORE_I;
+}
+
+/**
+ * Compile a function for lockstep execution.
+ *
+ * Only leaf functions that write nothing but their own locals are supported, so every lane can run against a
+ * private copy of the slots the function touches without any lane observing another.
+ */
+static void qcvm_compileWide(QC_VM *vm, QC_Uint32 fnIdx, QC_VM_WideFn *ret){
+	const auto fn = &vm->fnTable[fnIdx];
+
+	ret->supported = false;
+	ret->entry = fn->entry;
+	ret->code.clear();
+	ret->slots.clear();
+
+	if(fn->fn.base.type != QC_VM_FN_BYTECODE || fn->entry == 0 || !qcvm_ensureFn(vm, fn->entry)){
+		return;
+	}
+
+	// the function ends at the next entry point or module boundary
+	auto end = QC_Uint32(vm->code.size());
+
+	for(const auto &linkedFn : vm->fnTable){
+		if(linkedFn.entry > fn->entry) end = QC_MIN(end, linkedFn.entry);
+	}
+
+	for(const auto &mod : vm->modules){
+		if(mod.stmtBase > fn->entry) end = QC_MIN(end, mod.stmtBase);
+	}
+
+	const auto numGlobals = qcvm_numGlobals(vm);
+	const auto isWritable = [&](QC_Uint32 slot){
+		return (slot >= QCVM_OFS_RETURN && slot < QCVM_NUM_RESERVED_GLOBALS)
+			|| (slot >= fn->localIdx && slot < (fn->localIdx + fn->numLocals));
+	};
+
+	for(QC_Uint32 i = 0; i < fn->numLocals; i++){
+		ret->slots.emplace_back(fn->localIdx + i);
+	}
+
+	for(QC_Uint32 pc = fn->entry; pc < end; pc++){
+		const auto st = &vm->code[pc];
+
+		if(!qcvm_wideSupported(st->op)){
+			return;
+		}
+
+		if(st->op == QC_OP_GOTO || st->op == QC_OP_IF || st->op == QC_OP_IFNOT){
+			const auto target = QC_Int64(pc) + QC_Int32(st->op == QC_OP_GOTO ? st->a : st->b);
+			if(target < fn->entry || target >= end){
+				return;
+			}
+		}
+
+		const auto destSlots = qcvm_wideDestSlots(st->op);
+		const auto dest = qcvm_wideDestIsB(st->op) ? st->b : st->c;
+
+		for(QC_Uint32 j = 0; j < destSlots; j++){
+			if(!isWritable(dest + j)) return;
+		}
+
+		const auto operands = qcvm_opGlobalOperands(st->op);
+		const QC_Uint32 operandSlots[] = { st->a, st->b, st->c };
+
+		for(QC_Uint32 j = 0; j < 3; j++){
+			if(!(operands & (1u << j))) continue;
+
+			for(QC_Uint32 k = 0; k < 3 && (operandSlots[j] + k) < numGlobals; k++){
+				ret->slots.emplace_back(operandSlots[j] + k);
+			}
+		}
+	}
+
+	// consecutive globals stay consecutive so vector operands can be indexed directly
+	std::sort(ret->slots.begin(), ret->slots.end());
+	ret->slots.erase(std::unique(ret->slots.begin(), ret->slots.end()), ret->slots.end());
+
+	const auto wideSlot = [&](QC_Uint32 slot){
+		return QC_Uint32(std::lower_bound(ret->slots.begin(), ret->slots.end(), slot) - ret->slots.begin());
+	};
+
+	ret->localBase = wideSlot(fn->localIdx);
+	ret->code.reserve(end - fn->entry);
+
+	for(QC_Uint32 pc = fn->entry; pc < end; pc++){
+		auto st = vm->code[pc];
+		const auto operands = qcvm_opGlobalOperands(st.op);
+
+		if(operands & 0x1) st.a = wideSlot(st.a);
+		if(operands & 0x2) st.b = wideSlot(st.b);
+		if(operands & 0x4) st.c = wideSlot(st.c);
+
+		ret->code.emplace_back(st);
+	}
+
+	ret->supported = true;
+}
+
+static bool qcvm_execWideChunk(
+	const QC_VM *vm, const QC_VM_LinkedFn *fn, const QC_VM_WideFn *wide, QC_VM_Slot *mem,
+	QC_Uint32 nLanes, QC_Uint32 nArgs, const QC_Value *args, QC_Value *rets
+){
+	const auto nSlots = QC_Uint32(wide->slots.size());
+
+	for(QC_Uint32 w = 0; w < nSlots; w++){
+		std::fill_n(mem + (w * QCVM_WIDE_LANES), QCVM_WIDE_LANES, vm->globalMem[wide->slots[w]]);
+	}
+
+	// parameters are copied straight into each lane's locals
+	for(QC_Uint32 l = 0; l < nLanes; l++){
+		auto w = QC_Uint32(0);
+
+		for(QC_Uint32 i = 0; i < nArgs; i++){
+			const auto argSize = QC_MIN(QC_MAX(QC_Uint32(fn->argSizes[i]), 1u), 3u);
+
+			QC_VM_Slot argSlots[3];
+			std::memcpy(argSlots, args + (l * nArgs) + i, sizeof(argSlots));
+
+			for(QC_Uint32 j = 0; j < argSize && w < fn->numLocals; j++, w++){
+				mem[((wide->localBase + w) * QCVM_WIDE_LANES) + l] = argSlots[j];
+			}
+		}
+	}
+
+	QC_Uint32 pcs[QCVM_WIDE_LANES] = { 0 };
+	QC_Uint32 live = (1u << nLanes) - 1u;
+
+#define QCVM_WA(j) (mem + ((st->a + (j)) * QCVM_WIDE_LANES))
+#define QCVM_WB(j) (mem + ((st->b + (j)) * QCVM_WIDE_LANES))
+#define QCVM_WC(j) (mem + ((st->c + (j)) * QCVM_WIDE_LANES))
+
+#define QCVM_WIDE_F(dst, expr) qcvm_wideStore(laneMask, dst, [&](QC_Uint32 l){ return QC_VM_Slot{ .f32 = QC_Float(expr) }; })
+#define QCVM_WIDE_I(dst, expr) qcvm_wideStore(laneMask, dst, [&](QC_Uint32 l){ return QC_VM_Slot{ .i32 = QC_Int32(expr) }; })
+
+	while(live){
+		// run the lowest statement any lane is waiting on, lanes reconverge when they reach the same statement
+		auto pc = UINT32_MAX;
+
+		for(QC_Uint32 l = 0; l < QCVM_WIDE_LANES; l++){
+			if(live & (1u << l)) pc = QC_MIN(pc, pcs[l]);
+		}
+
+		QC_Uint32 laneMask[QCVM_WIDE_LANES];
+		QC_Uint32 active = 0;
+
+		for(QC_Uint32 l = 0; l < QCVM_WIDE_LANES; l++){
+			const bool on = (live & (1u << l)) && pcs[l] == pc;
+			laneMask[l] = on ? UINT32_MAX : 0u;
+			active |= QC_Uint32(on) << l;
+		}
+
+		const auto st = wide->code.data() + pc;
+		auto advance = [&](auto &&offset){
+			for(QC_Uint32 l = 0; l < QCVM_WIDE_LANES; l++){
+				if(active & (1u << l)) pcs[l] += offset(l);
+			}
+		};
+
+		switch(st->op){
+			case QC_OP_DONE:
+			case QC_OP_RETURN:{
+				for(QC_Uint32 l = 0; l < QCVM_WIDE_LANES; l++){
+					if(!(active & (1u << l))) continue;
+
+					const QC_VM_Slot retSlots[] = { QCVM_WA(0)[l], QCVM_WA(1)[l], QCVM_WA(2)[l] };
+					std::memset(rets + l, 0, sizeof(QC_Value));
+					std::memcpy(rets + l, retSlots, sizeof(retSlots));
+				}
+
+				live &= ~active;
+				continue;
+			}
+
+			case QC_OP_GOTO: advance([&](QC_Uint32){ return QC_Int32(st->a); }); continue;
+			case QC_OP_IF: advance([&](QC_Uint32 l){ return QCVM_WA(0)[l].u32 ? QC_Int32(st->b) : 1; }); continue;
+			case QC_OP_IFNOT: advance([&](QC_Uint32 l){ return QCVM_WA(0)[l].u32 ? 1 : QC_Int32(st->b); }); continue;
+
+			case QC_OP_MUL_F: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 * QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_MUL_V:{
+				QCVM_WIDE_F(
+					QCVM_WC(0),
+					QCVM_WA(0)[l].f32 * QCVM_WB(0)[l].f32 + QCVM_WA(1)[l].f32 * QCVM_WB(1)[l].f32 + QCVM_WA(2)[l].f32 * QCVM_WB(2)[l].f32
+				);
+				break;
+			}
+
+			case QC_OP_MUL_FV:{
+				QC_VM_Slot f[QCVM_WIDE_LANES];
+				std::copy_n(QCVM_WA(0), QCVM_WIDE_LANES, f);
+
+				for(QC_Uint32 j = 0; j < 3; j++){
+					QCVM_WIDE_F(QCVM_WC(j), f[l].f32 * QCVM_WB(j)[l].f32);
+				}
+				break;
+			}
+
+			case QC_OP_MUL_VF:{
+				QC_VM_Slot f[QCVM_WIDE_LANES];
+				std::copy_n(QCVM_WB(0), QCVM_WIDE_LANES, f);
+
+				for(QC_Uint32 j = 0; j < 3; j++){
+					QCVM_WIDE_F(QCVM_WC(j), QCVM_WA(j)[l].f32 * f[l].f32);
+				}
+				break;
+			}
+
+			case QC_OP_DIV_F: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 / QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_DIV_VF:{
+				QC_VM_Slot f[QCVM_WIDE_LANES];
+				std::copy_n(QCVM_WB(0), QCVM_WIDE_LANES, f);
+
+				if(vm->fastMath){
+					// one division per lane instead of three
+					for(auto &slot : f) slot.f32 = 1.f / slot.f32;
+
+					for(QC_Uint32 j = 0; j < 3; j++){
+						QCVM_WIDE_F(QCVM_WC(j), QCVM_WA(j)[l].f32 * f[l].f32);
+					}
+					break;
+				}
+
+				for(QC_Uint32 j = 0; j < 3; j++){
+					QCVM_WIDE_F(QCVM_WC(j), QCVM_WA(j)[l].f32 / f[l].f32);
+				}
+				break;
+			}
+
+			case QC_OP_ADD_F: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 + QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_ADD_V:{
+				for(QC_Uint32 j = 0; j < 3; j++){
+					QCVM_WIDE_F(QCVM_WC(j), QCVM_WA(j)[l].f32 + QCVM_WB(j)[l].f32);
+				}
+				break;
+			}
+
+			case QC_OP_SUB_F: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 - QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_SUB_V:{
+				for(QC_Uint32 j = 0; j < 3; j++){
+					QCVM_WIDE_F(QCVM_WC(j), QCVM_WA(j)[l].f32 - QCVM_WB(j)[l].f32);
+				}
+				break;
+			}
+
+			case QC_OP_EQ_F: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 == QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_EQ_V:{
+				QCVM_WIDE_F(
+					QCVM_WC(0),
+					QCVM_WA(0)[l].f32 == QCVM_WB(0)[l].f32 && QCVM_WA(1)[l].f32 == QCVM_WB(1)[l].f32 && QCVM_WA(2)[l].f32 == QCVM_WB(2)[l].f32
+				);
+				break;
+			}
+
+			case QC_OP_EQ_E:
+			case QC_OP_EQ_FNC:
+				QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].u32 == QCVM_WB(0)[l].u32);
+				break;
+
+			case QC_OP_NE_F: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 != QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_NE_V:{
+				QCVM_WIDE_F(
+					QCVM_WC(0),
+					QCVM_WA(0)[l].f32 != QCVM_WB(0)[l].f32 || QCVM_WA(1)[l].f32 != QCVM_WB(1)[l].f32 || QCVM_WA(2)[l].f32 != QCVM_WB(2)[l].f32
+				);
+				break;
+			}
+
+			case QC_OP_NE_E:
+			case QC_OP_NE_FNC:
+				QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].u32 != QCVM_WB(0)[l].u32);
+				break;
+
+			case QC_OP_LE: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 <= QCVM_WB(0)[l].f32); break;
+			case QC_OP_GE: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 >= QCVM_WB(0)[l].f32); break;
+			case QC_OP_LT: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 < QCVM_WB(0)[l].f32); break;
+			case QC_OP_GT: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 > QCVM_WB(0)[l].f32); break;
+
+			case QC_OP_STORE_F:
+			case QC_OP_STORE_S:
+			case QC_OP_STORE_ENT:
+			case QC_OP_STORE_FLD:
+			case QC_OP_STORE_FNC:
+			case QC_OP_STORE_I:
+				QCVM_WIDE_I(QCVM_WB(0), QCVM_WA(0)[l].i32);
+				break;
+
+			case QC_OP_STORE_V:{
+				for(QC_Uint32 j = 0; j < 3; j++){
+					QCVM_WIDE_I(QCVM_WB(j), QCVM_WA(j)[l].i32);
+				}
+				break;
+			}
+
+			case QC_OP_NOT_F: QCVM_WIDE_F(QCVM_WC(0), !QCVM_WA(0)[l].f32); break;
+			case QC_OP_NOT_V: QCVM_WIDE_F(QCVM_WC(0), !QCVM_WA(0)[l].f32 && !QCVM_WA(1)[l].f32 && !QCVM_WA(2)[l].f32); break;
+
+			case QC_OP_NOT_ENT:
+			case QC_OP_NOT_FNC:
+				QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].u32 == 0);
+				break;
+
+			case QC_OP_AND: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 && QCVM_WB(0)[l].f32); break;
+			case QC_OP_OR: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].f32 || QCVM_WB(0)[l].f32); break;
+			case QC_OP_BITAND: QCVM_WIDE_F(QCVM_WC(0), QC_Int32(QCVM_WA(0)[l].f32) & QC_Int32(QCVM_WB(0)[l].f32)); break;
+			case QC_OP_BITOR: QCVM_WIDE_F(QCVM_WC(0), QC_Int32(QCVM_WA(0)[l].f32) | QC_Int32(QCVM_WB(0)[l].f32)); break;
+
+			case QC_OP_ADD_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 + QCVM_WB(0)[l].i32); break;
+			case QC_OP_SUB_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 - QCVM_WB(0)[l].i32); break;
+			case QC_OP_MUL_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 * QCVM_WB(0)[l].i32); break;
+			case QC_OP_EQ_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 == QCVM_WB(0)[l].i32); break;
+			case QC_OP_NE_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 != QCVM_WB(0)[l].i32); break;
+			case QC_OP_LE_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 <= QCVM_WB(0)[l].i32); break;
+			case QC_OP_GE_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 >= QCVM_WB(0)[l].i32); break;
+			case QC_OP_LT_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 < QCVM_WB(0)[l].i32); break;
+			case QC_OP_GT_I: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].i32 > QCVM_WB(0)[l].i32); break;
+			case QC_OP_CONV_ITOF: QCVM_WIDE_F(QCVM_WC(0), QCVM_WA(0)[l].i32); break;
+			case QC_OP_CONV_FTOI: QCVM_WIDE_I(QCVM_WC(0), QCVM_WA(0)[l].f32); break;
+
+			default:{
+				qcLogError("internal error: op 0x%x is not supported in wide mode", st->op);
+				return false;
+			}
+		}
+
+		advance([](QC_Uint32){ return 1; });
+	}
+
+#undef QCVM_WIDE_I
+#undef QCVM_WIDE_F
+#undef QCVM_WC
+#undef QCVM_WB
+#undef QCVM_WA
+
+	return true;
+}
+
+bool qcvm_execWide(QC_VM *vm, QC_Uint32 fnIdx, QC_Uint32 nLanes, QC_Uint32 nArgs, QC_Value *args, QC_Value *rets){
+	auto res = vm->wideFns.find(fnIdx);
+	if(res == vm->wideFns.end()){
+		res = vm->wideFns.try_emplace(fnIdx).first;
+		qcvm_compileWide(vm, fnIdx, &res->second);
+	}
+
+	const auto wide = &res->second;
+
+	if(!wide->supported){
+		for(QC_Uint32 l = 0; l < nLanes; l++){
+			if(!qcvm_execLinked(vm, fnIdx, nArgs, args + (l * nArgs), rets + l)){
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	const auto fn = &vm->fnTable[fnIdx];
+
+	// zeroed rows after the last wide slot, RETURN always reads 3 slots like it does from QC_VM::globalMem
+	std::vector<QC_VM_Slot> mem((wide->slots.size() + QCVM_GLOBAL_PADDING) * QCVM_WIDE_LANES);
+
+	for(QC_Uint32 base = 0; base < nLanes; base += QCVM_WIDE_LANES){
+		const auto chunkLanes = QC_MIN(nLanes - base, QCVM_WIDE_LANES);
+
+		if(!qcvm_execWideChunk(vm, fn, wide, mem.data(), chunkLanes, nArgs, args + (base * nArgs), rets + base)){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
@@ -1,12 +1,26 @@
 #include "qcvm/vm.h"
+#include "qcvm/bytecode.h"
 #include "qcvm/lex.h"
 
 #include "qcvm/common.hpp"
 
+#include "qcvm/symtab.hpp"
+
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef QCVM_TEST_EMBED
+#include "qcvm_embed/highbit.h"
+#endif
 
 QC_Value qcvm_printFloatAndDouble(QC_VM*, void*, void **args){
 	const auto valPtr = reinterpret_cast<const QC_Float*>(args[0]);
@@ -95,3 +109,1808 @@ TEST_CASE( "simple lexing", "[lex]" ){
 		REQUIRE(token.str == expected.str);
 	}
 }
+
+TEST_CASE( "pure function memoisation", "[vm-memo]" ){
+	QC_VM *vm = qcCreateVM(0);
+
+	REQUIRE(vm);
+
+	QC_Uint32 numCalls = 0;
+
+	QC_VM_Fn_Native fn;
+	std::memset(&fn, 0, sizeof(fn));
+
+	const QC_Uint32 paramTypes[] = { QC_BYTECODE_TYPE_FLOAT };
+	const auto made = qcMakeNativeFn(
+		QC_BYTECODE_TYPE_FLOAT, 1, paramTypes,
+		[](QC_VM*, void *user, void **args) -> QC_Value{
+			++*reinterpret_cast<QC_Uint32*>(user);
+			return { .f32 = *reinterpret_cast<const QC_Float*>(args[0]) * 2.f };
+		},
+		&fn
+	);
+
+	REQUIRE(made);
+
+	fn.user = &numCalls;
+	QCVM_SUPER(&fn)->flags = QC_FUNCTION_PURE;
+
+	REQUIRE(qcVMSetMemoCapacity(vm, 16));
+
+	QC_Value arg = { .f32 = 4.f }, ret;
+
+	REQUIRE(qcVMExec(vm, QCVM_SUPER(&fn), 1, &arg, &ret));
+	REQUIRE(qcVMExec(vm, QCVM_SUPER(&fn), 1, &arg, &ret));
+	REQUIRE(ret.f32 == 8.f);
+	REQUIRE(numCalls == 1);
+
+	SECTION( "clearing the memo re-evaluates" ){
+		REQUIRE(qcVMClearMemo(vm));
+		REQUIRE(qcVMExec(vm, QCVM_SUPER(&fn), 1, &arg, &ret));
+		REQUIRE(numCalls == 2);
+	}
+
+	SECTION( "impure functions are never memoised" ){
+		QCVM_SUPER(&fn)->flags = 0;
+		REQUIRE(qcVMExec(vm, QCVM_SUPER(&fn), 1, &arg, &ret));
+		REQUIRE(numCalls == 2);
+	}
+
+	REQUIRE(qcDestroyVM(vm));
+}
+
+TEST_CASE( "symbol tables", "[symtab]" ){
+	std::vector<std::string> names;
+	for(QC_Uint32 i = 0; i < 300; i++){
+		names.emplace_back("sym" + std::to_string(i));
+	}
+
+	QC_VM_SymbolTable<QC_Uint32> tab;
+
+	const auto insert = [&](QC_Uint32 begin, QC_Uint32 end){
+		for(auto i = begin; i < end; i++){
+			const auto res = tab.tryEmplace(names[i]);
+			REQUIRE(res.second);
+			*res.first = i;
+		}
+	};
+
+	const auto check = [&](QC_Uint32 end){
+		for(QC_Uint32 i = 0; i < names.size(); i++){
+			const auto res = tab.find(names[i]);
+
+			if(i < end){
+				REQUIRE(res);
+				REQUIRE(*res == i);
+			}
+			else{
+				REQUIRE_FALSE(res);
+			}
+		}
+
+		REQUIRE_FALSE(tab.find(""));
+		REQUIRE_FALSE(tab.find("sym"));
+	};
+
+	insert(0, 100);
+	check(100);
+
+	const auto first = tab.find(names[0]);
+
+	tab.build();
+	REQUIRE(tab.pending.empty());
+	check(100);
+
+	SECTION( "inserts after a build are found before the next one" ){
+		insert(100, 200);
+		REQUIRE(tab.pending.size() == 100);
+		check(200);
+
+		tab.build();
+		REQUIRE(tab.pending.empty());
+		check(200);
+
+		// values keep their address across builds
+		REQUIRE(tab.find(names[0]) == first);
+	}
+
+	SECTION( "duplicate names return the existing symbol" ){
+		const auto built = tab.tryEmplace(names[5]);
+		REQUIRE_FALSE(built.second);
+		REQUIRE(*built.first == 5);
+
+		insert(100, 101);
+		const auto pending = tab.tryEmplace(std::string(names[100]), true);
+		REQUIRE_FALSE(pending.second);
+		REQUIRE(*pending.first == 100);
+
+		REQUIRE(tab.size() == 101);
+	}
+
+	SECTION( "copied keys outlive their source" ){
+		{
+			auto name = std::string("temporary");
+			*tab.tryEmplace(name, true).first = 1234;
+			name.assign("overwritten");
+		}
+
+		tab.build();
+
+		const auto res = tab.find("temporary");
+		REQUIRE(res);
+		REQUIRE(*res == 1234);
+	}
+}
+
+static QC_ByteCode *qcvm_buildTestModule(
+	std::initializer_list<QC_ByteCodeStatement> stmts,
+	std::initializer_list<std::pair<const char*, QC_ByteCodeFunction>> fns,
+	std::initializer_list<std::tuple<const char*, QC_Uint32, QC_Value>> globals,
+	std::initializer_list<std::tuple<const char*, QC_Uint32, QC_Uint32>> fields = {}
+){
+	const auto builder = qcCreateBuilder();
+
+	qcBuilderAddString(builder, "", 1);
+
+	for(QC_Uint32 i = 0; i < 28; i++){
+		qcBuilderAddGlobal(builder, QC_Value{ .u32 = 0 });
+	}
+
+	for(const auto &[name, type, value] : globals){
+		const auto nameIdx = qcBuilderAddString(builder, name, std::strlen(name) + 1);
+		const auto globalIdx = qcBuilderAddGlobal(builder, value);
+
+		if(type != QC_BYTECODE_TYPE_VOID){
+			const QC_ByteCodeDef def = { .type = type, .globalIdx = QC_Uint32(globalIdx), .nameIdx = QC_Uint32(nameIdx) };
+			qcBuilderAddDef(builder, &def);
+		}
+	}
+
+	for(const auto &[name, type, offset] : fields){
+		const auto nameIdx = qcBuilderAddString(builder, name, std::strlen(name) + 1);
+		const QC_ByteCodeField field = { .type = type, .offset = offset, .nameIdx = QC_Uint32(nameIdx) };
+		qcBuilderAddField(builder, &field);
+	}
+
+	for(const auto &stmt : stmts){
+		qcBuilderAddStatement(builder, &stmt);
+	}
+
+	const QC_ByteCodeFunction nullFn = {};
+	qcBuilderAddFunction(builder, &nullFn);
+
+	for(auto [name, fn] : fns){
+		fn.nameIdx = QC_Int32(qcBuilderAddString(builder, name, std::strlen(name) + 1));
+		qcBuilderAddFunction(builder, &fn);
+	}
+
+	const auto bc = qcBuilderEmit(builder);
+	qcDestroyBuilder(builder);
+	return bc;
+}
+
+TEST_CASE( "linking and executing bytecode", "[vm-link]" ){
+	// double(x) = x * scale; main(x) = double(x)
+	const auto bcA = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_MUL_F, 31, 28, 32 },
+			{ QC_OP_RETURN, 32, 0, 0 },
+			{ QC_OP_STORE_F, 33, 4, 0 },
+			{ QC_OP_CALL1, 29, 0, 0 },
+			{ QC_OP_RETURN, 1, 0, 0 },
+		},
+		{
+			{ "double", { .entryPoint = 1, .localIdx = 31, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+			{ "main", { .entryPoint = 3, .localIdx = 33, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "scale", QC_BYTECODE_TYPE_FLOAT, { .f32 = 2.f } },
+			{ "double", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "main", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	// declares double, quad(x) = double(double(x))
+	const auto bcB = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_STORE_F, 30, 4, 0 },
+			{ QC_OP_CALL1, 28, 0, 0 },
+			{ QC_OP_STORE_F, 1, 4, 0 },
+			{ QC_OP_CALL1, 28, 0, 0 },
+			{ QC_OP_RETURN, 1, 0, 0 },
+		},
+		{
+			{ "double", { .numArgs = 1, .argSizes = { 1 } } },
+			{ "quad", { .entryPoint = 1, .localIdx = 30, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "double", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "quad", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	REQUIRE(bcA);
+	REQUIRE(bcB);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+
+	REQUIRE(qcVMLoadByteCode(vm, bcA, 0));
+	REQUIRE(qcVMLoadByteCode(vm, bcB, 0));
+
+	const auto mainFn = qcVMFindFn(vm, "main", 4);
+	const auto quadFn = qcVMFindFn(vm, "quad", 4);
+	REQUIRE(mainFn);
+	REQUIRE(quadFn);
+
+	QC_Value arg = { .f32 = 3.f }, ret;
+
+	REQUIRE(qcVMExec(vm, mainFn, 1, &arg, &ret));
+	REQUIRE(ret.f32 == 6.f);
+
+	SECTION( "calls resolve across modules" ){
+		REQUIRE(qcVMExec(vm, quadFn, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 12.f);
+	}
+
+	SECTION( "globals are shared by name" ){
+		QC_VM_Value scale;
+		REQUIRE(qcVMGetGlobal(vm, "scale", 5, &scale));
+		REQUIRE(scale.value.f32 == 2.f);
+
+		scale.value.f32 = 3.f;
+		REQUIRE(qcVMSetGlobal(vm, "scale", 5, scale));
+
+		REQUIRE(qcVMExec(vm, quadFn, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 27.f);
+	}
+
+	SECTION( "handles resolve once and follow overrides" ){
+		QC_VM_GlobalHandle scaleH;
+		QC_VM_FnHandle doubleH;
+		REQUIRE(qcVMGlobalHandle(vm, "scale", 5, &scaleH));
+		REQUIRE(qcVMFnHandle(vm, "double", 6, &doubleH));
+		REQUIRE_FALSE(qcVMFnHandle(vm, "missing", 7, &doubleH));
+
+		REQUIRE(qcVMSetGlobalH(vm, scaleH, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 4.f } }));
+		REQUIRE(qcVMExecH(vm, doubleH, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 12.f);
+
+		// double(x) = x
+		const auto bcC = qcvm_buildTestModule(
+			{
+				{ QC_OP_DONE, 0, 0, 0 },
+				{ QC_OP_RETURN, 29, 0, 0 },
+			},
+			{
+				{ "double", { .entryPoint = 1, .localIdx = 29, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+			},
+			{
+				{ "double", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+				{ "", QC_BYTECODE_TYPE_VOID, {} },
+			}
+		);
+
+		REQUIRE(bcC);
+		REQUIRE(qcVMLoadByteCode(vm, bcC, QC_VM_LOAD_OVERRIDE_FNS));
+
+		REQUIRE(qcVMExecH(vm, doubleH, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 3.f);
+
+		QC_VM_Value scale;
+		REQUIRE(qcVMGetGlobalH(vm, scaleH, &scale));
+		REQUIRE(scale.value.f32 == 4.f);
+
+		REQUIRE(qcDestroyVM(vm));
+		vm = nullptr;
+		REQUIRE(qcDestroyByteCode(bcC));
+	}
+
+	if(vm) REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bcB));
+	REQUIRE(qcDestroyByteCode(bcA));
+}
+
+TEST_CASE( "linking string globals", "[vm-link]" ){
+	// the name of the unnamed global is an empty string at offset 7
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+		},
+		{},
+		{
+			{ "empty", QC_BYTECODE_TYPE_STRING, { .u32 = 7 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	const auto badBc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+		},
+		{},
+		{
+			{ "bad", QC_BYTECODE_TYPE_STRING, { .u32 = 1000 } },
+		}
+	);
+
+	REQUIRE(bc);
+	REQUIRE(badBc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+
+	REQUIRE_FALSE(qcVMLoadByteCode(vm, badBc, 0));
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	QC_VM_Value empty;
+	REQUIRE(qcVMGetGlobal(vm, "empty", 5, &empty));
+	REQUIRE(empty.value.u32 == 0);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(badBc));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "inferring and memoising pure bytecode", "[vm-memo]" ){
+	// sq(x) = x * x; twice(x) = sq(x) + sq(x); bump() = count += 1
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_MUL_F, 33, 33, 34 },
+			{ QC_OP_RETURN, 34, 0, 0 },
+			{ QC_OP_STORE_F, 35, 4, 0 },
+			{ QC_OP_CALL1, 28, 0, 0 },
+			{ QC_OP_STORE_F, 1, 36, 0 },
+			{ QC_OP_STORE_F, 35, 4, 0 },
+			{ QC_OP_CALL1, 28, 0, 0 },
+			{ QC_OP_ADD_F, 36, 1, 36 },
+			{ QC_OP_RETURN, 36, 0, 0 },
+			{ QC_OP_ADD_F, 32, 31, 32 },
+			{ QC_OP_RETURN, 32, 0, 0 },
+		},
+		{
+			{ "sq", { .entryPoint = 1, .localIdx = 33, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+			{ "twice", { .entryPoint = 3, .localIdx = 35, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+			{ "bump", { .entryPoint = 10 } },
+		},
+		{
+			{ "sq", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "twice", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+			{ "bump", QC_BYTECODE_TYPE_FUNC, { .u32 = 3 } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 1.f } },
+			{ "count", QC_BYTECODE_TYPE_FLOAT, { .f32 = 0.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, QC_VM_LOAD_INFER_PURE));
+
+	const auto sqFn = qcVMFindFn(vm, "sq", 2);
+	const auto twiceFn = qcVMFindFn(vm, "twice", 5);
+	const auto bumpFn = qcVMFindFn(vm, "bump", 4);
+	REQUIRE(sqFn);
+	REQUIRE(twiceFn);
+	REQUIRE(bumpFn);
+
+	REQUIRE(sqFn->flags & QC_FUNCTION_PURE);
+	REQUIRE(twiceFn->flags & QC_FUNCTION_PURE);
+	REQUIRE_FALSE(bumpFn->flags & QC_FUNCTION_PURE);
+
+	REQUIRE(qcVMSetMemoCapacity(vm, 16));
+	REQUIRE(qcVMSetProfiling(vm, true));
+
+	QC_Value arg = { .f32 = 3.f }, ret;
+
+	// the second bytecode call to sq hits the memo
+	REQUIRE(qcVMExec(vm, twiceFn, 1, &arg, &ret));
+	REQUIRE(ret.f32 == 18.f);
+
+	size_t numStmts;
+	auto profile = qcVMStmtProfile(vm, &numStmts);
+	REQUIRE(profile);
+	REQUIRE(profile[1].hits == 1);
+	REQUIRE(profile[3].hits == 1);
+
+	arg.f32 = 4.f;
+	REQUIRE(qcVMExec(vm, twiceFn, 1, &arg, &ret));
+	REQUIRE(ret.f32 == 32.f);
+
+	profile = qcVMStmtProfile(vm, &numStmts);
+	REQUIRE(profile[1].hits == 2);
+
+	SECTION( "impure bytecode is never memoised" ){
+		REQUIRE(qcVMExec(vm, bumpFn, 0, nullptr, &ret));
+		REQUIRE(qcVMExec(vm, bumpFn, 0, nullptr, &ret));
+		REQUIRE(ret.f32 == 2.f);
+	}
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "inferring purity across modules", "[vm-memo]" ){
+	// scaled(x) = x * scale
+	const auto bcA = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_MUL_F, 30, 28, 31 },
+			{ QC_OP_RETURN, 31, 0, 0 },
+		},
+		{
+			{ "scaled", { .entryPoint = 1, .localIdx = 30, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "scale", QC_BYTECODE_TYPE_FLOAT, { .f32 = 2.f } },
+			{ "scaled", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	// setScale() = scale = 3
+	const auto bcB = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_STORE_F, 30, 28, 0 },
+			{ QC_OP_DONE, 0, 0, 0 },
+		},
+		{
+			{ "setScale", { .entryPoint = 1 } },
+		},
+		{
+			{ "scale", QC_BYTECODE_TYPE_FLOAT, { .f32 = 2.f } },
+			{ "setScale", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 3.f } },
+		}
+	);
+
+	// snap(e) = g = e.health; get(x) = x + g
+	const auto bcC = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_LOAD_F, 32, 30, 31 },
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_ADD_F, 33, 31, 34 },
+			{ QC_OP_RETURN, 34, 0, 0 },
+		},
+		{
+			{ "snap", { .entryPoint = 1, .localIdx = 32, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+			{ "get", { .entryPoint = 3, .localIdx = 33, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "snap", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "get", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+			{ "health", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } },
+			{ "g", QC_BYTECODE_TYPE_FLOAT, { .f32 = 0.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		},
+		{
+			{ "health", QC_BYTECODE_TYPE_FLOAT, 0 },
+		}
+	);
+
+	REQUIRE(bcA);
+	REQUIRE(bcB);
+	REQUIRE(bcC);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMSetMemoCapacity(vm, 16));
+
+	QC_Value arg = { .f32 = 5.f }, ret;
+
+	SECTION( "a later module writing a global takes purity back" ){
+		REQUIRE(qcVMLoadByteCode(vm, bcA, QC_VM_LOAD_INFER_PURE));
+		REQUIRE(qcVMFindFn(vm, "scaled", 6)->flags & QC_FUNCTION_PURE);
+
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "scaled", 6), 1, &arg, &ret));
+		REQUIRE(ret.f32 == 10.f);
+
+		REQUIRE(qcVMLoadByteCode(vm, bcB, 0));
+
+		const auto scaledFn = qcVMFindFn(vm, "scaled", 6);
+		REQUIRE(scaledFn);
+		REQUIRE_FALSE(scaledFn->flags & QC_FUNCTION_PURE);
+
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "setScale", 8), 0, nullptr, &ret));
+		REQUIRE(qcVMExec(vm, scaledFn, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 15.f);
+	}
+
+	SECTION( "loads write globals too" ){
+		REQUIRE(qcVMLoadByteCode(vm, bcC, QC_VM_LOAD_INFER_PURE));
+
+		const auto getFn = qcVMFindFn(vm, "get", 3);
+		REQUIRE(getFn);
+		REQUIRE_FALSE(getFn->flags & QC_FUNCTION_PURE);
+
+		arg.f32 = 1.f;
+		REQUIRE(qcVMExec(vm, getFn, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 1.f);
+
+		QC_Entity ent;
+		REQUIRE(qcVMSpawnEntity(vm, &ent));
+		REQUIRE(qcVMSetField(vm, ent, "health", 6, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 5.f } }));
+
+		QC_Value entArg = { .u32 = qcEntityIndex(ent) };
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "snap", 4), 1, &entArg, &ret));
+		REQUIRE(qcVMExec(vm, getFn, 1, &arg, &ret));
+		REQUIRE(ret.f32 == 6.f);
+	}
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bcC));
+	REQUIRE(qcDestroyByteCode(bcB));
+	REQUIRE(qcDestroyByteCode(bcA));
+}
+
+TEST_CASE( "entity fields", "[vm-entity]" ){
+	// hurt(e, amount) = e.health = e.health - amount; poke(ptr, value) = *ptr = value
+	const auto bcA = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_LOAD_F, 30, 28, 32 },
+			{ QC_OP_SUB_F, 32, 31, 32 },
+			{ QC_OP_ADDRESS, 30, 28, 33 },
+			{ QC_OP_STOREP_F, 32, 33, 0 },
+			{ QC_OP_RETURN, 32, 0, 0 },
+			{ QC_OP_STOREP_F, 36, 35, 0 },
+			{ QC_OP_DONE, 0, 0, 0 },
+		},
+		{
+			{ "hurt", { .entryPoint = 1, .localIdx = 30, .numLocals = 4, .numArgs = 2, .argSizes = { 1, 1 } } },
+			{ "poke", { .entryPoint = 6, .localIdx = 35, .numLocals = 2, .numArgs = 2, .argSizes = { 1, 1 } } },
+		},
+		{
+			{ "health", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } },
+			{ "origin", QC_BYTECODE_TYPE_FIELD, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "time", QC_BYTECODE_TYPE_FLOAT, { .f32 = 0.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		},
+		{
+			{ "health", QC_BYTECODE_TYPE_FLOAT, 0 },
+			{ "origin", QC_BYTECODE_TYPE_VECTOR, 1 },
+		}
+	);
+
+	// declares speed before health, getSpeed(e) = e.speed
+	const auto bcB = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_LOAD_F, 30, 28, 31 },
+			{ QC_OP_RETURN, 31, 0, 0 },
+		},
+		{
+			{ "getSpeed", { .entryPoint = 1, .localIdx = 30, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "speed", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } },
+			{ "health", QC_BYTECODE_TYPE_FIELD, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		},
+		{
+			{ "speed", QC_BYTECODE_TYPE_FLOAT, 0 },
+			{ "health", QC_BYTECODE_TYPE_FLOAT, 1 },
+		}
+	);
+
+	REQUIRE(bcA);
+	REQUIRE(bcB);
+
+	const auto flags = GENERATE(0u, QC_Uint32(QC_VM_CREATE_ENTITY_SOA), QC_Uint32(QC_VM_CREATE_UNCHECKED_POINTERS));
+	const auto soa = (flags & QC_VM_CREATE_ENTITY_SOA) != 0;
+
+	QC_VM *vm = qcCreateVM(flags);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bcA, 0));
+	REQUIRE(qcVMNumEntityFields(vm) == 4);
+
+	QC_Entity ent;
+	REQUIRE(qcVMSpawnEntity(vm, &ent));
+	REQUIRE(ent != 0);
+	REQUIRE(qcVMSetField(vm, ent, "health", 6, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 10.f } }));
+
+	const auto hurtFn = qcVMFindFn(vm, "hurt", 4);
+	REQUIRE(hurtFn);
+
+	QC_Value args[] = { { .u32 = qcEntityIndex(ent) }, { .f32 = 3.f } }, ret;
+	REQUIRE(qcVMExec(vm, hurtFn, 2, args, &ret));
+	REQUIRE(ret.f32 == 7.f);
+
+	QC_VM_Value health;
+	REQUIRE(qcVMGetField(vm, ent, "health", 6, &health));
+	REQUIRE(health.value.f32 == 7.f);
+
+	SECTION( "fields are shared by name and blocks grow in place" ){
+		REQUIRE(qcVMLoadByteCode(vm, bcB, 0));
+		REQUIRE(qcVMNumEntityFields(vm) == 5);
+
+		REQUIRE(qcVMGetField(vm, ent, "health", 6, &health));
+		REQUIRE(health.value.f32 == 7.f);
+
+		REQUIRE(qcVMSetField(vm, ent, "speed", 5, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 5.f } }));
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "getSpeed", 8), 1, args, &ret));
+		REQUIRE(ret.f32 == 5.f);
+
+		REQUIRE(qcVMExec(vm, hurtFn, 2, args, &ret));
+		REQUIRE(ret.f32 == 4.f);
+	}
+
+	SECTION( "fields can not outgrow pointers that were taken" ){
+		// six more fields need another bit in hurt's field pointers
+		const auto bcC = qcvm_buildTestModule(
+			{ { QC_OP_DONE, 0, 0, 0 } },
+			{},
+			{
+				{ "f0", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } },
+				{ "f1", QC_BYTECODE_TYPE_FIELD, { .u32 = 1 } },
+				{ "f2", QC_BYTECODE_TYPE_FIELD, { .u32 = 2 } },
+				{ "f3", QC_BYTECODE_TYPE_FIELD, { .u32 = 3 } },
+				{ "f4", QC_BYTECODE_TYPE_FIELD, { .u32 = 4 } },
+				{ "f5", QC_BYTECODE_TYPE_FIELD, { .u32 = 5 } },
+			},
+			{
+				{ "f0", QC_BYTECODE_TYPE_FLOAT, 0 },
+				{ "f1", QC_BYTECODE_TYPE_FLOAT, 1 },
+				{ "f2", QC_BYTECODE_TYPE_FLOAT, 2 },
+				{ "f3", QC_BYTECODE_TYPE_FLOAT, 3 },
+				{ "f4", QC_BYTECODE_TYPE_FLOAT, 4 },
+				{ "f5", QC_BYTECODE_TYPE_FLOAT, 5 },
+			}
+		);
+
+		REQUIRE(bcC);
+		REQUIRE_FALSE(qcVMLoadByteCode(vm, bcC, 0));
+		REQUIRE(qcVMNumEntityFields(vm) == 4);
+
+		REQUIRE(qcVMExec(vm, hurtFn, 2, args, &ret));
+		REQUIRE(ret.f32 == 4.f);
+
+		// nothing has taken a pointer in a fresh VM yet
+		QC_VM *fresh = qcCreateVM(flags);
+		REQUIRE(fresh);
+		REQUIRE(qcVMLoadByteCode(fresh, bcA, 0));
+		REQUIRE(qcVMLoadByteCode(fresh, bcC, 0));
+		REQUIRE(qcVMNumEntityFields(fresh) == 10);
+
+		REQUIRE(qcDestroyVM(fresh));
+		REQUIRE(qcDestroyByteCode(bcC));
+	}
+
+	SECTION( "bulk field access" ){
+		QC_Entity other;
+		REQUIRE(qcVMSpawnEntity(vm, &other));
+		REQUIRE(qcVMNumEntities(vm) == 3);
+
+		const QC_Vector origin = { 1.f, 2.f, 3.f };
+		REQUIRE(qcVMSetField(vm, other, "origin", 6, QC_VM_Value{ .type = QC_BYTECODE_TYPE_VECTOR, .value = { .v32 = origin } }));
+
+		QC_Uintptr entStride, compStride;
+		const auto data = static_cast<const QC_Float*>(qcVMFieldData(vm, "origin", 6, &entStride, &compStride));
+		REQUIRE(data);
+		REQUIRE((soa ? entStride == 1 : compStride == 1));
+
+		const auto otherOrigin = data + (qcEntityIndex(other) * entStride);
+		REQUIRE(otherOrigin[0] == 1.f);
+		REQUIRE(otherOrigin[compStride] == 2.f);
+		REQUIRE(otherOrigin[2 * compStride] == 3.f);
+	}
+
+	SECTION( "invalid entities are rejected" ){
+		// forged pointers are caught when stored through, unless checks are off
+		if(!(flags & QC_VM_CREATE_UNCHECKED_POINTERS)){
+			QC_Value pokeArgs[] = { { .u32 = 0x7fffffffu }, { .f32 = 1.f } };
+			REQUIRE_FALSE(qcVMExec(vm, qcVMFindFn(vm, "poke", 4), 2, pokeArgs, &ret));
+		}
+
+		args[0].u32 = 1000;
+		REQUIRE_FALSE(qcVMExec(vm, hurtFn, 2, args, &ret));
+		REQUIRE_FALSE(qcVMRemoveEntity(vm, 0));
+
+		REQUIRE(qcVMRemoveEntity(vm, ent));
+		REQUIRE_FALSE(qcVMGetField(vm, ent, "health", 6, &health));
+
+		QC_Entity reused;
+		REQUIRE(qcVMSpawnEntity(vm, &reused));
+		REQUIRE(qcEntityIndex(reused) == qcEntityIndex(ent));
+		REQUIRE(reused != ent);
+		REQUIRE(qcVMGetField(vm, reused, "health", 6, &health));
+		REQUIRE(health.value.f32 == 0.f);
+
+		// stale handles stay invalid after the index is reused
+		REQUIRE_FALSE(qcVMGetField(vm, ent, "health", 6, &health));
+	}
+
+	SECTION( "removed entities are reused after a delay" ){
+		REQUIRE(qcVMSetEntityReuseDelay(vm, 0.5f));
+		REQUIRE(qcVMSetGlobal(vm, "time", 4, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 10.f } }));
+		REQUIRE(qcVMRemoveEntity(vm, ent));
+
+		QC_Entity next;
+		REQUIRE(qcVMSpawnEntity(vm, &next));
+		REQUIRE(qcEntityIndex(next) != qcEntityIndex(ent));
+
+		REQUIRE(qcVMSetGlobal(vm, "time", 4, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 10.5f } }));
+		REQUIRE(qcVMSpawnEntity(vm, &next));
+		REQUIRE(qcEntityIndex(next) == qcEntityIndex(ent));
+	}
+
+	SECTION( "live entities are listed in order" ){
+		QC_Entity more[4];
+		for(auto &e : more) REQUIRE(qcVMSpawnEntity(vm, &e));
+
+		REQUIRE(qcVMRemoveEntity(vm, ent));
+		REQUIRE(qcVMRemoveEntity(vm, more[2]));
+
+		size_t numLive;
+		const auto live = qcVMLiveEntities(vm, &numLive);
+		REQUIRE(live);
+		REQUIRE(numLive == 3);
+		REQUIRE(live[0] == qcEntityIndex(more[0]));
+		REQUIRE(live[1] == qcEntityIndex(more[1]));
+		REQUIRE(live[2] == qcEntityIndex(more[3]));
+
+		REQUIRE(qcVMSpawnEntity(vm, &ent));
+		REQUIRE(qcVMLiveEntities(vm, &numLive)[0] == qcEntityIndex(ent));
+		REQUIRE(numLive == 4);
+
+		// gaps longer than a word of the live set
+		std::vector<QC_Entity> row(200);
+		for(auto &e : row) REQUIRE(qcVMSpawnEntity(vm, &e));
+		for(QC_Uint32 i = 0; i < row.size(); i++){
+			if(i != 63 && i != 64 && i != 199) REQUIRE(qcVMRemoveEntity(vm, row[i]));
+		}
+
+		const auto builtins = qcVMDefaultBuiltins(vm);
+		REQUIRE(qcEntityIndex(builtins->nextent(vm, more[3])) == qcEntityIndex(row[63]));
+		REQUIRE(qcEntityIndex(builtins->nextent(vm, row[63])) == qcEntityIndex(row[64]));
+		REQUIRE(qcEntityIndex(builtins->nextent(vm, row[64])) == qcEntityIndex(row[199]));
+		REQUIRE(builtins->nextent(vm, row[199]) == 0);
+		REQUIRE(qcVMLiveEntities(vm, &numLive)[numLive - 1] == qcEntityIndex(row[199]));
+		REQUIRE(numLive == 7);
+	}
+
+	SECTION( "field changes are tracked by sequence" ){
+		using Changes = std::set<std::pair<QC_Uint32, QC_Uint32>>;
+
+		const auto collect = [vm](QC_Uint32 sinceSeq){
+			Changes ret;
+			REQUIRE(qcVMForEachChange(vm, sinceSeq, [](void *user, QC_Uint32 e, QC_Uint32 field){
+				static_cast<Changes*>(user)->emplace(e, field);
+			}, &ret));
+			return ret;
+		};
+
+		QC_Uint32 healthField, originField;
+		REQUIRE(qcVMFieldOffset(vm, "health", 6, &healthField));
+		REQUIRE(qcVMFieldOffset(vm, "origin", 6, &originField));
+
+		REQUIRE(qcVMSetChangeTracking(vm, true));
+		REQUIRE(collect(0).empty());
+
+		const auto first = qcVMChangeSeq(vm);
+		REQUIRE(qcVMExec(vm, hurtFn, 2, args, &ret));
+
+		const auto second = qcVMAdvanceChangeSeq(vm);
+		REQUIRE(qcVMSetField(vm, ent, "origin", 6, QC_VM_Value{ .type = QC_BYTECODE_TYPE_VECTOR, .value = { .v32 = { 1.f, 2.f, 3.f } } }));
+
+		const auto e = qcEntityIndex(ent);
+		REQUIRE(collect(first) == Changes{ { e, healthField }, { e, originField }, { e, originField + 1 }, { e, originField + 2 } });
+		REQUIRE(collect(second) == Changes{ { e, originField }, { e, originField + 1 }, { e, originField + 2 } });
+
+		REQUIRE(qcVMClearChanges(vm, second));
+		REQUIRE(collect(first) == collect(second));
+		REQUIRE(qcVMClearChanges(vm, qcVMAdvanceChangeSeq(vm)));
+		REQUIRE(collect(0).empty());
+
+		// spawning marks every field
+		QC_Entity other;
+		REQUIRE(qcVMSpawnEntity(vm, &other));
+		REQUIRE(collect(0).size() == qcVMNumEntityFields(vm));
+	}
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bcB));
+	REQUIRE(qcDestroyByteCode(bcA));
+}
+
+TEST_CASE( "findradius", "[vm-entity]" ){
+	// near(org, rad) = findradius(org, rad); place(e, org) = e.origin = org
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_CALL2H, 30, 32, 35 },
+			{ QC_OP_RETURN, 1, 0, 0 },
+			{ QC_OP_ADDRESS, 36, 28, 40 },
+			{ QC_OP_STOREP_V, 37, 40, 0 },
+			{ QC_OP_RETURN, 0, 0, 0 },
+		},
+		{
+			{ "findradius", { .entryPoint = -22, .numArgs = 2, .argSizes = { 3, 1 } } },
+			{ "near", { .entryPoint = 1, .localIdx = 32, .numLocals = 4, .numArgs = 2, .argSizes = { 3, 1 } } },
+			{ "place", { .entryPoint = 3, .localIdx = 36, .numLocals = 5, .numArgs = 2, .argSizes = { 1, 3 } } },
+		},
+		{
+			{ "origin", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } },
+			{ "chain", QC_BYTECODE_TYPE_FIELD, { .u32 = 3 } },
+			{ "findradius", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		},
+		{
+			{ "origin", QC_BYTECODE_TYPE_VECTOR, 0 },
+			{ "chain", QC_BYTECODE_TYPE_ENTITY, 3 },
+			{ "mins", QC_BYTECODE_TYPE_VECTOR, 4 },
+			{ "maxs", QC_BYTECODE_TYPE_VECTOR, 7 },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(QC_VM_CREATE_DEFAULT_BUILTINS);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	const auto indexed = GENERATE(false, true);
+	if(indexed) REQUIRE(qcVMSetSpatialIndex(vm, 128.f));
+
+	// a row of entities 100 units apart
+	std::vector<QC_Entity> row(50);
+	for(QC_Uint32 i = 0; i < row.size(); i++){
+		REQUIRE(qcVMSpawnEntity(vm, &row[i]));
+
+		const QC_Vector origin = { QC_Float(i) * 100.f, 0.f, 0.f };
+		REQUIRE(qcVMSetField(vm, row[i], "origin", 6, QC_VM_Value{ .type = QC_BYTECODE_TYPE_VECTOR, .value = { .v32 = origin } }));
+	}
+
+	const auto nearFn = qcVMFindFn(vm, "near", 4);
+	REQUIRE(nearFn);
+
+	const auto countChain = [vm](QC_Uint32 head){
+		QC_Uint32 n = 0;
+
+		for(QC_Entity ent; head != 0 && qcVMEntityHandle(vm, head, &ent); n++){
+			QC_VM_Value next;
+			REQUIRE(qcVMGetField(vm, ent, "chain", 5, &next));
+			REQUIRE(next.value.u32 < head);
+			head = next.value.u32;
+		}
+
+		return n;
+	};
+
+	QC_Value args[] = { { .v32 = { 1000.f, 0.f, 0.f } }, { .f32 = 250.f } }, ret;
+	REQUIRE(qcVMExec(vm, nearFn, 2, args, &ret));
+	REQUIRE(ret.u32 == qcEntityIndex(row[12]));
+	REQUIRE(countChain(ret.u32) == 5);
+
+	// moved by bytecode and the host
+	QC_Value placeArgs[] = { { .u32 = qcEntityIndex(row[40]) }, { .v32 = { 1010.f, 50.f, 0.f } } };
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "place", 5), 2, placeArgs, &ret));
+	REQUIRE(qcVMRemoveEntity(vm, row[8]));
+
+	REQUIRE(qcVMExec(vm, nearFn, 2, args, &ret));
+	REQUIRE(ret.u32 == qcEntityIndex(row[40]));
+	REQUIRE(countChain(ret.u32) == 5);
+
+	// measured to the bounding box center, 2000 units back from the origin
+	const QC_Vector mins = { -4000.f, 0.f, 0.f };
+	REQUIRE(qcVMSetField(vm, row[30], "mins", 4, QC_VM_Value{ .type = QC_BYTECODE_TYPE_VECTOR, .value = { .v32 = mins } }));
+
+	REQUIRE(qcVMExec(vm, nearFn, 2, args, &ret));
+	REQUIRE(ret.u32 == qcEntityIndex(row[40]));
+	REQUIRE(countChain(ret.u32) == 6);
+
+	// linking the chain is a field change like any other
+	QC_Uint32 chainField;
+	REQUIRE(qcVMFieldOffset(vm, "chain", 5, &chainField));
+	REQUIRE(qcVMSetChangeTracking(vm, true));
+
+	const auto seq = qcVMAdvanceChangeSeq(vm);
+	REQUIRE(qcVMExec(vm, nearFn, 2, args, &ret));
+
+	std::pair<QC_Uint32, QC_Uint32> chainChanges = { chainField, 0 };
+	REQUIRE(qcVMForEachChange(vm, seq, [](void *user, QC_Uint32, QC_Uint32 field){
+		const auto counts = static_cast<std::pair<QC_Uint32, QC_Uint32>*>(user);
+		if(field == counts->first) counts->second++;
+	}, &chainChanges));
+
+	REQUIRE(chainChanges.second == 6);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "find", "[vm-entity]" ){
+	const auto bc = qcvm_buildTestModule(
+		{ { QC_OP_DONE, 0, 0, 0 } },
+		{},
+		{ { "classname", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } } },
+		{ { "classname", QC_BYTECODE_TYPE_STRING, 0 } }
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(QC_VM_CREATE_DEFAULT_BUILTINS);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	const auto builtins = qcVMDefaultBuiltins(vm);
+
+	// classnames "0", "1" and "2" repeating
+	const QC_String names[] = { builtins->ftos(vm, 0.f), builtins->ftos(vm, 1.f), builtins->ftos(vm, 2.f) };
+
+	const auto mode = GENERATE(0, 1, 2);
+	if(mode == 1) REQUIRE(qcVMSetFindIndex(vm, "classname", 9, true));
+	else if(mode == 2) REQUIRE(qcVMSetFindAutoIndex(vm, 2));
+
+	std::vector<QC_Entity> ents(30);
+	for(QC_Uint32 i = 0; i < ents.size(); i++){
+		REQUIRE(qcVMSpawnEntity(vm, &ents[i]));
+		REQUIRE(qcVMSetField(vm, ents[i], "classname", 9, QC_VM_Value{ .type = QC_BYTECODE_TYPE_STRING, .value = { .u32 = names[i % 3] } }));
+	}
+
+	// a fresh string with the same contents still matches
+	const auto match = builtins->ftos(vm, 1.f);
+
+	const auto countMatches = [&]{
+		QC_Uint32 n = 0;
+		QC_Entity prev = 0;
+
+		for(auto e = builtins->find(vm, 0, 0, match); e; e = builtins->find(vm, e, 0, match), n++){
+			REQUIRE(qcEntityIndex(e) > qcEntityIndex(prev));
+			prev = e;
+		}
+
+		return n;
+	};
+
+	REQUIRE(countMatches() == 10);
+	REQUIRE(countMatches() == 10);
+
+	REQUIRE(qcVMRemoveEntity(vm, ents[4]));
+	REQUIRE(qcVMSetField(vm, ents[6], "classname", 9, QC_VM_Value{ .type = QC_BYTECODE_TYPE_STRING, .value = { .u32 = match } }));
+	REQUIRE(qcEntityIndex(builtins->find(vm, 0, 0, match)) == qcEntityIndex(ents[1]));
+	REQUIRE(countMatches() == 10);
+
+	// an empty field matches an empty string, with or without an index
+	REQUIRE(qcVMSetField(vm, ents[9], "classname", 9, QC_VM_Value{ .type = QC_BYTECODE_TYPE_STRING, .value = { .u32 = 0 } }));
+	REQUIRE(qcEntityIndex(builtins->find(vm, 0, 0, 0)) == qcEntityIndex(ents[9]));
+	REQUIRE(builtins->find(vm, ents[9], 0, 0) == 0);
+
+	// nextent skips the removed entity
+	REQUIRE(qcEntityIndex(builtins->nextent(vm, ents[3])) == qcEntityIndex(ents[5]));
+
+	REQUIRE(!qcVMSetFindIndex(vm, "nothing", 7, true));
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "think scheduling", "[vm-entity]" ){
+	// tick() = counter += 1; [5, tick]; later(e) = e.nextthink = time + 1
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_ADD_F, 34, 35, 34 },
+			{ QC_OP_STATE, 36, 33, 0 },
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_THINKTIME, 37, 35, 0 },
+			{ QC_OP_DONE, 0, 0, 0 },
+		},
+		{
+			{ "tick", { .entryPoint = 1, .localIdx = 37, .numLocals = 0 } },
+			{ "later", { .entryPoint = 4, .localIdx = 37, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "nextthink", QC_BYTECODE_TYPE_FIELD, { .u32 = 0 } },
+			{ "think", QC_BYTECODE_TYPE_FIELD, { .u32 = 1 } },
+			{ "frame", QC_BYTECODE_TYPE_FIELD, { .u32 = 2 } },
+			{ "self", QC_BYTECODE_TYPE_ENTITY, {} },
+			{ "time", QC_BYTECODE_TYPE_FLOAT, {} },
+			{ "tick", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "counter", QC_BYTECODE_TYPE_FLOAT, { .f32 = 0.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 1.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 5.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		},
+		{
+			{ "nextthink", QC_BYTECODE_TYPE_FLOAT, 0 },
+			{ "think", QC_BYTECODE_TYPE_FUNC, 1 },
+			{ "frame", QC_BYTECODE_TYPE_FLOAT, 2 },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	QC_VM_Value tick, value;
+	REQUIRE(qcVMGetGlobal(vm, "tick", 4, &tick));
+
+	const auto getFloat = [vm](QC_Entity e, const char *name){
+		QC_VM_Value v;
+		REQUIRE(qcVMGetField(vm, e, name, std::strlen(name), &v));
+		return v.value.f32;
+	};
+
+	const auto counter = [vm]{
+		QC_VM_Value v;
+		REQUIRE(qcVMGetGlobal(vm, "counter", 7, &v));
+		return v.value.f32;
+	};
+
+	// due at 1, 0.5, 2 and never
+	const QC_Float due[] = { 1.f, 0.5f, 2.f, 0.f };
+	QC_Entity ents[4];
+
+	for(QC_Uint32 i = 0; i < 4; i++){
+		REQUIRE(qcVMSpawnEntity(vm, &ents[i]));
+		REQUIRE(qcVMSetField(vm, ents[i], "think", 5, tick));
+		REQUIRE(qcVMSetField(vm, ents[i], "nextthink", 9, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = due[i] } }));
+	}
+
+	// later() only touches time and its local, which then move ahead of self and counter
+	const auto relayout = GENERATE(false, true);
+	if(relayout){
+		QC_Value arg = { .u32 = qcEntityIndex(ents[3]) }, unused;
+		REQUIRE(qcVMSetProfiling(vm, true));
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "later", 5), 1, &arg, &unused));
+		REQUIRE(qcVMSetProfiling(vm, false));
+		REQUIRE(qcVMRelayoutGlobals(vm));
+		REQUIRE(qcVMSetField(vm, ents[3], "nextthink", 9, QC_VM_Value{ .type = QC_BYTECODE_TYPE_FLOAT, .value = { .f32 = 0.f } }));
+	}
+
+	REQUIRE(qcVMRunThinks(vm, 1.f));
+	REQUIRE(counter() == 2.f);
+	REQUIRE(getFloat(ents[0], "frame") == 5.f);
+	REQUIRE(getFloat(ents[1], "nextthink") == Approx(0.6f));
+	REQUIRE(getFloat(ents[0], "nextthink") == Approx(1.1f));
+	REQUIRE(getFloat(ents[2], "frame") == 0.f);
+
+	REQUIRE(qcVMGetGlobal(vm, "time", 4, &value));
+	REQUIRE(value.value.f32 == 1.f);
+
+	// rescheduled from bytecode, and removed before it was due
+	QC_Value args[] = { { .u32 = qcEntityIndex(ents[2]) } }, ret;
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "later", 5), 1, args, &ret));
+	REQUIRE(qcVMRemoveEntity(vm, ents[0]));
+
+	REQUIRE(qcVMRunThinks(vm, 1.9f));
+	REQUIRE(counter() == 3.f);
+	REQUIRE(getFloat(ents[2], "nextthink") == 2.f);
+
+	REQUIRE(qcVMRunThinks(vm, 2.f));
+	REQUIRE(counter() == 5.f);
+	REQUIRE(getFloat(ents[3], "frame") == 0.f);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "swapping builtins while running", "[vm-builtins]" ){
+	// main() = value()
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_CALL0, 28, 0, 0 },
+			{ QC_OP_RETURN, 1, 0, 0 },
+		},
+		{
+			{ "value", { .entryPoint = -1 } },
+			{ "main", { .entryPoint = 1 } },
+		},
+		{
+			{ "value", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "main", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+
+	const auto makeValueFn = [](QC_BuiltinFn ptr){
+		QC_VM_Fn_Native fn;
+		std::memset(&fn, 0, sizeof(fn));
+		qcMakeNativeFn(QC_BYTECODE_TYPE_FLOAT, 0, nullptr, ptr, &fn);
+		return fn;
+	};
+
+	const auto oneFn = makeValueFn([](QC_VM*, void*, void**) -> QC_Value{ return { .f32 = 1.f }; });
+	const auto twoFn = makeValueFn([](QC_VM*, void*, void**) -> QC_Value{ return { .f32 = 2.f }; });
+
+	REQUIRE(qcVMSetBuiltin(vm, 1, oneFn, false));
+	REQUIRE_FALSE(qcVMSetBuiltin(vm, 1, twoFn, false));
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	const auto mainFn = qcVMFindFn(vm, "main", 4);
+	REQUIRE(mainFn);
+
+	QC_Value ret;
+	REQUIRE(qcVMExec(vm, mainFn, 0, nullptr, &ret));
+	REQUIRE(ret.f32 == 1.f);
+
+	std::atomic<bool> stop = false;
+	std::thread swapper([&]{
+		for(QC_Uint32 i = 0; !stop.load(); i++){
+			qcVMSetBuiltin(vm, 1, (i & 1u) ? oneFn : twoFn, true);
+		}
+	});
+
+	bool allValid = true;
+	for(QC_Uint32 i = 0; i < 10000; i++){
+		allValid = qcVMExec(vm, mainFn, 0, nullptr, &ret) && (ret.f32 == 1.f || ret.f32 == 2.f) && allValid;
+	}
+
+	stop.store(true);
+	swapper.join();
+
+	REQUIRE(allValid);
+
+	REQUIRE(qcVMSetBuiltin(vm, 1, twoFn, true));
+	REQUIRE(qcVMExec(vm, mainFn, 0, nullptr, &ret));
+	REQUIRE(ret.f32 == 2.f);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "swapping named builtins while running", "[vm-builtins]" ){
+	// main() = floor(0)
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_CALL1, 28, 0, 0 },
+			{ QC_OP_RETURN, 1, 0, 0 },
+		},
+		{
+			{ "floor", { .entryPoint = -37, .numArgs = 1, .argSizes = { 1 } } },
+			{ "main", { .entryPoint = 1 } },
+		},
+		{
+			{ "floor", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "main", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(QC_VM_CREATE_DEFAULT_BUILTINS);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	const auto mainFn = qcVMFindFn(vm, "main", 4);
+	REQUIRE(mainFn);
+
+	// keeps the name the default builtin was registered with
+	QC_VM_Fn_Native floorFn;
+	REQUIRE(qcVMGetBuiltin(vm, 37, &floorFn));
+	REQUIRE(QCVM_SUPER(&floorFn)->nameIdx != 0);
+
+	auto oneFn = floorFn, twoFn = floorFn;
+	oneFn.ptr = [](QC_VM*, void*, void**) -> QC_Value{ return { .f32 = 1.f }; };
+	twoFn.ptr = [](QC_VM*, void*, void**) -> QC_Value{ return { .f32 = 2.f }; };
+
+	REQUIRE(qcVMSetBuiltin(vm, 37, oneFn, true));
+
+	std::atomic<bool> stop = false;
+	std::thread swapper([&]{
+		for(QC_Uint32 i = 0; !stop.load(); i++){
+			qcVMSetBuiltin(vm, 37, (i & 1u) ? oneFn : twoFn, true);
+		}
+	});
+
+	bool allValid = true;
+	QC_Value ret;
+	for(QC_Uint32 i = 0; i < 10000; i++){
+		allValid = qcVMExec(vm, mainFn, 0, nullptr, &ret) && (ret.f32 == 1.f || ret.f32 == 2.f) && allValid;
+	}
+
+	stop.store(true);
+	swapper.join();
+
+	REQUIRE(allValid);
+	REQUIRE(qcVMFindFn(vm, "floor", 5) != nullptr);
+
+	SECTION( "renaming and flag changes need a stopped VM" ){
+		static QC_VM_Fn_Native movedFn;
+		static bool movedOk, flagsOk;
+
+		movedFn = oneFn;
+
+		auto probeFn = twoFn;
+		probeFn.ptr = [](QC_VM *vm, void*, void**) -> QC_Value{
+			movedOk = qcVMSetBuiltin(vm, 100, movedFn, true);
+			flagsOk = qcVMSetFnFlags(vm, "main", 4, QC_FUNCTION_PURE);
+			return { .f32 = 3.f };
+		};
+
+		REQUIRE(qcVMSetBuiltin(vm, 37, probeFn, true));
+		REQUIRE(qcVMExec(vm, mainFn, 0, nullptr, &ret));
+		REQUIRE(ret.f32 == 3.f);
+		REQUIRE_FALSE(movedOk);
+		REQUIRE_FALSE(flagsOk);
+
+		REQUIRE(qcVMSetFnFlags(vm, "main", 4, QC_FUNCTION_PURE));
+		REQUIRE(qcVMSetBuiltin(vm, 100, movedFn, true));
+	}
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "profile-guided block reordering", "[vm-layout]" ){
+	// f(x) = r = 0; while(x > 0){ if(x == 1000) r = -1; r += x; x -= 1; } return r
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_STORE_F, 31, 30, 0 },
+			{ QC_OP_GT, 28, 31, 29 },
+			{ QC_OP_IFNOT, 29, 7, 0 },
+			{ QC_OP_EQ_F, 28, 33, 29 },
+			{ QC_OP_IFNOT, 29, 2, 0 },
+			{ QC_OP_STORE_F, 34, 30, 0 },
+			{ QC_OP_ADD_F, 30, 28, 30 },
+			{ QC_OP_SUB_F, 28, 32, 28 },
+			{ QC_OP_GOTO, QC_Uint32(-7), 0, 0 },
+			{ QC_OP_RETURN, 30, 0, 0 },
+		},
+		{
+			{ "f", { .entryPoint = 1, .localIdx = 28, .numLocals = 3, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 0.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 1.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 1000.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = -1.f } },
+			{ "f", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+		}
+	);
+
+	REQUIRE(bc);
+
+	const auto run = [](QC_VM *vm, QC_Float x){
+		QC_Value arg = { .f32 = x }, ret = {};
+		const auto fn = qcVMFindFn(vm, "f", 1);
+		return fn && qcVMExec(vm, fn, 1, &arg, &ret) ? ret.f32 : -12345.f;
+	};
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	REQUIRE_FALSE(qcVMReorderBlocks(vm));
+
+	REQUIRE(qcVMSetProfiling(vm, true));
+	REQUIRE(run(vm, 5.f) == 15.f);
+	REQUIRE(qcVMSetProfiling(vm, false));
+
+	size_t numStmts;
+	const auto profile = qcVMStmtProfile(vm, &numStmts);
+	REQUIRE(profile);
+	REQUIRE(numStmts == 11);
+	REQUIRE(profile[2].hits == 6);
+	REQUIRE(profile[3].taken == 1);
+	REQUIRE(profile[6].hits == 0);
+
+	const std::vector<QC_VM_StmtProfile> saved(profile, profile + numStmts);
+
+	REQUIRE(qcVMReorderBlocks(vm));
+	REQUIRE(run(vm, 5.f) == 15.f);
+	REQUIRE(run(vm, 1000.f) == 500499.f);
+	REQUIRE(run(vm, 0.f) == 0.f);
+
+	SECTION( "saved profiles can be applied to a fresh VM" ){
+		QC_VM *other = qcCreateVM(0);
+		REQUIRE(other);
+		REQUIRE(qcVMLoadByteCode(other, bc, 0));
+		REQUIRE(qcVMSetStmtProfile(other, saved.data(), saved.size()));
+		REQUIRE(qcVMReorderBlocks(other));
+		REQUIRE(run(other, 1000.f) == 500499.f);
+
+		// reordering twice follows the relocated bodies
+		REQUIRE(qcVMReorderBlocks(other));
+		REQUIRE(run(other, 5.f) == 15.f);
+		REQUIRE(qcDestroyVM(other));
+	}
+
+	SECTION( "globals are moved by access count" ){
+		size_t numGlobals;
+		REQUIRE(qcVMGlobalProfile(vm, &numGlobals));
+		REQUIRE(numGlobals == 36);
+
+		REQUIRE(qcVMRelayoutGlobals(vm));
+
+		const auto counts = qcVMGlobalProfile(vm, &numGlobals);
+		REQUIRE(counts);
+		REQUIRE(std::is_partitioned(counts + 28, counts + numGlobals, [](QC_Uint64 n){ return n > 0; }));
+
+		REQUIRE(run(vm, 1000.f) == 500499.f);
+		REQUIRE(run(vm, 5.f) == 15.f);
+	}
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "strict and fast-math float operations", "[vm-math]" ){
+	// div(a, b) = a / b; vlen2(v, f) = (v / f) * (v / f)
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_DIV_F, 28, 29, 30 },
+			{ QC_OP_RETURN, 30, 0, 0 },
+			{ QC_OP_DIV_VF, 31, 34, 35 },
+			{ QC_OP_MUL_V, 35, 35, 38 },
+			{ QC_OP_RETURN, 38, 0, 0 },
+		},
+		{
+			{ "div", { .entryPoint = 1, .localIdx = 28, .numLocals = 3, .numArgs = 2, .argSizes = { 1, 1 } } },
+			{ "vlen2", { .entryPoint = 3, .localIdx = 31, .numLocals = 8, .numArgs = 2, .argSizes = { 3, 1 } } },
+		},
+		{
+			{ "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} }, { "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "div", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "vlen2", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+		}
+	);
+
+	REQUIRE(bc);
+
+	const auto flags = GENERATE(0u, QC_Uint32(QC_VM_CREATE_FAST_MATH));
+	const auto strict = flags == 0;
+
+	QC_VM *vm = qcCreateVM(flags);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	const auto check = [strict](QC_Float value, QC_Float expected){
+		if(strict){
+			REQUIRE(value == expected);
+		}
+		else{
+			REQUIRE(value == Approx(expected).epsilon(1e-5));
+		}
+	};
+
+	QC_Value args[2], ret;
+
+	args[0].f32 = 1.f;
+	args[1].f32 = 3.f;
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "div", 3), 2, args, &ret));
+	check(ret.f32, 1.f / 3.f);
+
+	args[0].v32 = QC_Vector{ 3.f, 4.f, 0.f };
+	args[1].f32 = 2.f;
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "vlen2", 5), 2, args, &ret));
+	check(ret.f32, 6.25f);
+
+	const auto norm = qcVMDefaultBuiltins(vm)->normalize(vm, QC_Vector{ 0.f, 3.f, 4.f });
+	check(norm.x, 0.f);
+	check(norm.y, 0.6f);
+	check(norm.z, 0.8f);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "loading 16 and 32-bit progs", "[bytecode]" ){
+	const auto wide = GENERATE(false, true);
+
+	// locals x, tmp and r, then the constants 0 and 1 and f itself
+	const QC_Uint32 base = wide ? 70000 : 28;
+
+	// f(x) = r = 0; while(x > 0){ r += x; x -= 1; } return r
+	const QC_ByteCodeStatement32 stmts[] = {
+		{ QC_OP_DONE, 0, 0, 0 },
+		{ QC_OP_STORE_F, base + 3, base + 2, 0 },
+		{ QC_OP_GT, base, base + 3, base + 1 },
+		{ QC_OP_IFNOT, base + 1, 4, 0 },
+		{ QC_OP_ADD_F, base + 2, base, base + 2 },
+		{ QC_OP_SUB_F, base, base + 4, base },
+		{ QC_OP_GOTO, QC_Uint32(-4), 0, 0 },
+		{ QC_OP_RETURN, base + 2, 0, 0 },
+	};
+
+	const QC_ByteCodeDef32 def = { .type = QC_BYTECODE_TYPE_FUNC, .globalIdx = base + 5, .nameIdx = 1 };
+	const QC_ByteCodeField32 field = { .type = QC_BYTECODE_TYPE_FLOAT, .offset = base, .nameIdx = 3 };
+
+	const QC_ByteCodeFunction fns[] = {
+		{},
+		{ .entryPoint = 1, .localIdx = QC_Int32(base), .numLocals = 3, .nameIdx = 1, .numArgs = 1, .argSizes = { 1 } },
+	};
+
+	const char strs[] = "\0f\0health";
+
+	const QC_Float one = 1.f;
+
+	std::vector<QC_Uint32> globals(base + 6);
+	std::memcpy(globals.data() + base + 4, &one, sizeof(one));
+	globals[base + 5] = 1;
+
+	// 32-bit tables are announced by the FTE secondary version
+	QC_ByteCodeHeaderFTE header = {
+		.base = { .ver = wide ? QC_BYTECODE_VERSION_FTE : QC_BYTECODE_VERSION, .entityFields = base + 1 },
+		.secondaryVer = QC_BYTECODE_FTE_SECONDARY_32,
+	};
+
+	const auto headerSize = wide ? sizeof(QC_ByteCodeHeaderFTE) : sizeof(QC_ByteCodeHeader);
+	std::vector<char> bytes(headerSize);
+
+	const auto addSection = [&](QC_Section section, const void *data, size_t size, size_t count){
+		header.base.sectionData[section * 2] = QC_Uint32(bytes.size());
+		header.base.sectionData[(section * 2) + 1] = QC_Uint32(count);
+		bytes.insert(bytes.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	};
+
+	if(wide){
+		addSection(QC_SECTION_STATEMENTS, stmts, sizeof(stmts), std::size(stmts));
+		addSection(QC_SECTION_DEFS, &def, sizeof(def), 1);
+		addSection(QC_SECTION_FIELDS, &field, sizeof(field), 1);
+	}
+	else{
+		std::vector<QC_ByteCodeStatement16> narrowStmts;
+		for(const auto &st : stmts){
+			narrowStmts.push_back({ QC_Uint16(st.op), QC_Uint16(st.a), QC_Uint16(st.b), QC_Uint16(st.c) });
+		}
+
+		const QC_ByteCodeDef16 narrowDef = { QC_Uint16(def.type), QC_Uint16(def.globalIdx), def.nameIdx };
+		const QC_ByteCodeField16 narrowField = { QC_Uint16(field.type), QC_Uint16(field.offset), field.nameIdx };
+
+		addSection(QC_SECTION_STATEMENTS, narrowStmts.data(), narrowStmts.size() * sizeof(narrowStmts[0]), narrowStmts.size());
+		addSection(QC_SECTION_DEFS, &narrowDef, sizeof(narrowDef), 1);
+		addSection(QC_SECTION_FIELDS, &narrowField, sizeof(narrowField), 1);
+	}
+
+	addSection(QC_SECTION_FUNCTIONS, fns, sizeof(fns), std::size(fns));
+	addSection(QC_SECTION_STRINGS, strs, sizeof(strs), sizeof(strs));
+	addSection(QC_SECTION_GLOBALS, globals.data(), globals.size() * sizeof(QC_Uint32), globals.size());
+
+	std::memcpy(bytes.data(), &header, headerSize);
+
+	SECTION( "rejecting inconsistent headers" ){
+		auto bad = header;
+
+		// the field at offset base no longer fits in the entity
+		bad.base.entityFields = base;
+		std::memcpy(bytes.data(), &bad, headerSize);
+		REQUIRE_FALSE(qcCreateByteCode(bytes.data(), bytes.size()));
+
+		bad = header;
+		bad.base.ver = 0x5;
+		std::memcpy(bytes.data(), &bad, headerSize);
+		REQUIRE_FALSE(qcCreateByteCode(bytes.data(), bytes.size()));
+
+		if(wide){
+			bad = header;
+			bad.secondaryVer = 0x32;
+			std::memcpy(bytes.data(), &bad, headerSize);
+			REQUIRE_FALSE(qcCreateByteCode(bytes.data(), bytes.size()));
+		}
+
+		std::memcpy(bytes.data(), &header, headerSize);
+	}
+
+	const auto bc = qcCreateByteCode(bytes.data(), bytes.size());
+	REQUIRE(bc);
+	REQUIRE(qcByteCodeNumStatements(bc) == std::size(stmts));
+	REQUIRE(qcByteCodeStatements(bc)[6].a == QC_Uint32(-4));
+	REQUIRE(qcByteCodeStatements(bc)[2].c == base + 1);
+	REQUIRE(qcByteCodeDefs(bc)[0].globalIdx == base + 5);
+	REQUIRE(qcByteCodeFields(bc)[0].offset == base);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	QC_Value arg = { .f32 = 4.f }, ret;
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "f", 1), 1, &arg, &ret));
+	REQUIRE(ret.f32 == 10.f);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+#ifdef QCVM_TEST_EMBED
+TEST_CASE( "embedded progs", "[bytecode]" ){
+	// test/progs/highbit.dat: greeting = "caf\xc3\xa9 \xff"; name() = greeting; 4 entity fields, none named
+	const auto bc = highbit_createByteCode();
+	REQUIRE(bc);
+	REQUIRE(qcByteCodeStringsSize(bc) == 23);
+	REQUIRE(qcByteCodeNumEntityFields(bc) == 4);
+	REQUIRE(std::memcmp(qcByteCodeStrings(bc) + 15, "caf\xc3\xa9 \xff", 8) == 0);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+	REQUIRE(qcVMNumEntityFields(vm) == 4);
+
+	QC_Value ret = {};
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "name", 4), 0, nullptr, &ret));
+	REQUIRE(ret.u32 != 0);
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+#endif
+
+TEST_CASE( "wide execution", "[vm-wide]" ){
+	// f(x) = x < 0 ? -x : x * scale
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_LT, 31, 29, 32 },
+			{ QC_OP_IFNOT, 32, 3, 0 },
+			{ QC_OP_SUB_F, 29, 31, 32 },
+			{ QC_OP_RETURN, 32, 0, 0 },
+			{ QC_OP_MUL_F, 31, 28, 32 },
+			{ QC_OP_RETURN, 32, 0, 0 },
+		},
+		{
+			{ "f", { .entryPoint = 1, .localIdx = 31, .numLocals = 2, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "scale", QC_BYTECODE_TYPE_FLOAT, { .f32 = 2.f } },
+			{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 0.f } },
+			{ "f", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	const auto fn = qcVMFindFn(vm, "f", 1);
+	REQUIRE(fn);
+
+	constexpr QC_Float inputs[] = { -1.f, 2.f, -3.f, 4.f, 0.f, 5.f, -6.f, 7.f, 8.f, -9.f };
+	constexpr QC_Uint32 nLanes = std::size(inputs);
+
+	QC_Value args[nLanes], rets[nLanes];
+
+	for(QC_Uint32 i = 0; i < nLanes; i++){
+		args[i].f32 = inputs[i];
+	}
+
+	REQUIRE(qcVMExecWide(vm, fn, nLanes, 1, args, rets));
+
+	for(QC_Uint32 i = 0; i < nLanes; i++){
+		QC_Value scalarRet;
+		REQUIRE(qcVMExec(vm, fn, 1, args + i, &scalarRet));
+		REQUIRE(rets[i].f32 == scalarRet.f32);
+		REQUIRE(rets[i].f32 == (inputs[i] < 0.f ? -inputs[i] : inputs[i] * 2.f));
+	}
+
+	SECTION( "returning the last global" ){
+		// g() = last, the 3 slots RETURN reads run past the end of the globals
+		const auto lastBc = qcvm_buildTestModule(
+			{
+				{ QC_OP_DONE, 0, 0, 0 },
+				{ QC_OP_RETURN, 29, 0, 0 },
+			},
+			{
+				{ "g", { .entryPoint = 1 } },
+			},
+			{
+				{ "g", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+				{ "last", QC_BYTECODE_TYPE_FLOAT, { .f32 = 3.f } },
+			}
+		);
+
+		REQUIRE(lastBc);
+		REQUIRE(qcVMLoadByteCode(vm, lastBc, 0));
+
+		const auto gFn = qcVMFindFn(vm, "g", 1);
+		REQUIRE(gFn);
+		REQUIRE(qcVMExecWide(vm, gFn, nLanes, 0, nullptr, rets));
+
+		for(QC_Uint32 i = 0; i < nLanes; i++){
+			REQUIRE(rets[i].f32 == 3.f);
+		}
+
+		REQUIRE(qcDestroyVM(vm));
+		vm = nullptr;
+		REQUIRE(qcDestroyByteCode(lastBc));
+	}
+
+	if(vm) REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "stack overflow", "[vm-stack]" ){
+	// rec(x) = rec(x); id(x) = x
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_STORE_F, 30, 4, 0 },
+			{ QC_OP_CALL1, 28, 0, 0 },
+			{ QC_OP_RETURN, 1, 0, 0 },
+			{ QC_OP_RETURN, 31, 0, 0 },
+		},
+		{
+			{ "rec", { .entryPoint = 1, .localIdx = 30, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+			{ "id", { .entryPoint = 4, .localIdx = 31, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+		},
+		{
+			{ "rec", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "id", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+	REQUIRE(qcVMLoadByteCode(vm, bc, 0));
+
+	QC_Value arg = { .f32 = 1.f }, ret;
+
+	REQUIRE_FALSE(qcVMExec(vm, qcVMFindFn(vm, "rec", 3), 1, &arg, &ret));
+
+	// the VM is still usable afterwards
+	REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "id", 2), 1, &arg, &ret));
+	REQUIRE(ret.f32 == 1.f);
+
+	// and the next overflow is caught too
+	REQUIRE_FALSE(qcVMExec(vm, qcVMFindFn(vm, "rec", 3), 1, &arg, &ret));
+
+	REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
+
+TEST_CASE( "lazy function validation", "[vm-lazy]" ){
+	// good(x) = x; bad() refers to a global that doesn't exist
+	const auto bc = qcvm_buildTestModule(
+		{
+			{ QC_OP_DONE, 0, 0, 0 },
+			{ QC_OP_RETURN, 29, 0, 0 },
+			{ QC_OP_ADD_F, 1000, 30, 30 },
+			{ QC_OP_RETURN, 30, 0, 0 },
+		},
+		{
+			{ "good", { .entryPoint = 1, .localIdx = 29, .numLocals = 1, .numArgs = 1, .argSizes = { 1 } } },
+			{ "bad", { .entryPoint = 2, .localIdx = 30, .numLocals = 1 } },
+		},
+		{
+			{ "good", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+			{ "", QC_BYTECODE_TYPE_VOID, {} },
+		}
+	);
+
+	REQUIRE(bc);
+
+	QC_VM *vm = qcCreateVM(0);
+	REQUIRE(vm);
+
+	SECTION( "eager loading rejects the module" ){
+		REQUIRE_FALSE(qcVMLoadByteCode(vm, bc, 0));
+
+		// nothing from a failed load is left behind
+		REQUIRE_FALSE(qcVMFindFn(vm, "good", 4));
+	}
+
+	SECTION( "lazy loading only validates called functions" ){
+		REQUIRE(qcVMLoadByteCode(vm, bc, QC_VM_LOAD_LAZY));
+
+		QC_Value arg = { .f32 = 4.f }, ret;
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "good", 4), 1, &arg, &ret));
+		REQUIRE(ret.f32 == 4.f);
+
+		REQUIRE_FALSE(qcVMExec(vm, qcVMFindFn(vm, "bad", 3), 0, nullptr, &ret));
+		REQUIRE_FALSE(qcVMWarmAll(vm));
+	}
+
+	SECTION( "operands are checked against their width" ){
+		// last() returns the last global as a scalar; vec() copies a vector starting 1 slot before the end
+		const auto widthBc = qcvm_buildTestModule(
+			{
+				{ QC_OP_DONE, 0, 0, 0 },
+				{ QC_OP_RETURN, 31, 0, 0 },
+				{ QC_OP_STORE_V, 30, 4, 0 },
+				{ QC_OP_RETURN, 4, 0, 0 },
+			},
+			{
+				{ "last", { .entryPoint = 1 } },
+				{ "vec", { .entryPoint = 2 } },
+			},
+			{
+				{ "last", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+				{ "vec", QC_BYTECODE_TYPE_FUNC, { .u32 = 2 } },
+				{ "", QC_BYTECODE_TYPE_VOID, {} },
+				{ "", QC_BYTECODE_TYPE_VOID, { .f32 = 7.f } },
+			}
+		);
+
+		REQUIRE(widthBc);
+		REQUIRE_FALSE(qcVMLoadByteCode(vm, widthBc, 0));
+		REQUIRE(qcVMLoadByteCode(vm, widthBc, QC_VM_LOAD_LAZY));
+
+		QC_Value ret;
+		REQUIRE(qcVMExec(vm, qcVMFindFn(vm, "last", 4), 0, nullptr, &ret));
+		REQUIRE(ret.f32 == 7.f);
+
+		REQUIRE_FALSE(qcVMExec(vm, qcVMFindFn(vm, "vec", 3), 0, nullptr, &ret));
+
+		REQUIRE(qcDestroyVM(vm));
+		vm = nullptr;
+		REQUIRE(qcDestroyByteCode(widthBc));
+	}
+
+	SECTION( "bodies must end in a return or jump" ){
+		// falls off the end of the code
+		const auto openBc = qcvm_buildTestModule(
+			{
+				{ QC_OP_DONE, 0, 0, 0 },
+				{ QC_OP_ADD_F, 29, 29, 29 },
+			},
+			{
+				{ "open", { .entryPoint = 1 } },
+			},
+			{
+				{ "open", QC_BYTECODE_TYPE_FUNC, { .u32 = 1 } },
+				{ "", QC_BYTECODE_TYPE_VOID, {} },
+			}
+		);
+
+		REQUIRE(openBc);
+		REQUIRE_FALSE(qcVMLoadByteCode(vm, openBc, 0));
+		REQUIRE(qcVMLoadByteCode(vm, openBc, QC_VM_LOAD_LAZY));
+
+		QC_Value ret;
+		REQUIRE_FALSE(qcVMExec(vm, qcVMFindFn(vm, "open", 4), 0, nullptr, &ret));
+
+		REQUIRE(qcDestroyVM(vm));
+		vm = nullptr;
+		REQUIRE(qcDestroyByteCode(openBc));
+	}
+
+	if(vm) REQUIRE(qcDestroyVM(vm));
+	REQUIRE(qcDestroyByteCode(bc));
+}
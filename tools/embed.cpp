@@ -0,0 +1,135 @@
+#include "qcvm/bytecode.h"
+
+#include "fmt/format.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+// qcvm-embed <progs.dat> <output header> <symbol prefix>
+
+template<typename T, typename Fn>
+static void qcvm_writeSection(std::string &out, std::string_view prefix, std::string_view name, std::string_view type, const T *data, QC_Uintptr n, Fn &&writeElem){
+	if(!n){
+		return;
+	}
+
+	out += fmt::format("inline constexpr {} {}_{}[] = {{\n", type, prefix, name);
+
+	for(QC_Uintptr i = 0; i < n; i++){
+		out += '\t';
+		writeElem(out, data[i]);
+		out += ",\n";
+	}
+
+	out += "};\n\n";
+}
+
+int main(int argc, char *argv[]){
+	if(argc != 4){
+		std::fprintf(stderr, "Usage: %s <progs.dat> <output header> <symbol prefix>\n", argv[0]);
+		return 1;
+	}
+
+	const std::string_view inPath = argv[1];
+	const std::string_view prefix = argv[3];
+
+	std::ifstream inFile(argv[1], std::ios::binary);
+	if(!inFile){
+		qcLogError("could not open '%s'", argv[1]);
+		return 1;
+	}
+
+	const std::vector<char> bytes{ std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>() };
+
+	// runs the regular loader and its validation
+	const auto bc = qcCreateByteCode(bytes.data(), bytes.size());
+	if(!bc){
+		qcLogError("invalid bytecode in '%s'", argv[1]);
+		return 1;
+	}
+
+	const auto stmts = qcByteCodeStatements(bc);
+	const auto numStmts = qcByteCodeNumStatements(bc);
+	const auto defs = qcByteCodeDefs(bc);
+	const auto numDefs = qcByteCodeNumDefs(bc);
+	const auto fields = qcByteCodeFields(bc);
+	const auto numFields = qcByteCodeNumFields(bc);
+	const auto fns = qcByteCodeFunctions(bc);
+	const auto numFns = qcByteCodeNumFunctions(bc);
+	const auto globals = qcByteCodeGlobals(bc);
+	const auto numGlobals = qcByteCodeNumGlobals(bc);
+	const auto strs = qcByteCodeStrings(bc);
+	const auto strsSize = qcByteCodeStringsSize(bc);
+	const auto numEntityFields = qcByteCodeNumEntityFields(bc);
+
+	const auto guard = fmt::format("QCVM_EMBED_{}_H", prefix);
+
+	std::string out;
+
+	out += fmt::format("// Generated by qcvm-embed from {}, do not edit\n\n", inPath);
+	out += fmt::format("#ifndef {0}\n#define {0} 1\n\n", guard);
+	out += "#include \"qcvm/bytecode.h\"\n\n";
+
+	qcvm_writeSection(out, prefix, "stmts", "QC_ByteCodeStatement", stmts, numStmts, [](std::string &o, const QC_ByteCodeStatement &stmt){
+		o += fmt::format("{{ {}, {}, {}, {} }}", stmt.op, stmt.a, stmt.b, stmt.c);
+	});
+
+	qcvm_writeSection(out, prefix, "defs", "QC_ByteCodeDef", defs, numDefs, [](std::string &o, const QC_ByteCodeDef &def){
+		o += fmt::format("{{ {}, {}, {} }}", def.type, def.globalIdx, def.nameIdx);
+	});
+
+	qcvm_writeSection(out, prefix, "fields", "QC_ByteCodeField", fields, numFields, [](std::string &o, const QC_ByteCodeField &field){
+		o += fmt::format("{{ {}, {}, {} }}", field.type, field.offset, field.nameIdx);
+	});
+
+	qcvm_writeSection(out, prefix, "fns", "QC_ByteCodeFunction", fns, numFns, [](std::string &o, const QC_ByteCodeFunction &fn){
+		o += fmt::format(
+			"{{ {}, {}, {}, {}, {}, {}, {}, {{ {}, {}, {}, {}, {}, {}, {}, {} }} }}",
+			fn.entryPoint, fn.localIdx, fn.numLocals, fn.profile, fn.nameIdx, fn.fileIdx, fn.numArgs,
+			fn.argSizes[0], fn.argSizes[1], fn.argSizes[2], fn.argSizes[3],
+			fn.argSizes[4], fn.argSizes[5], fn.argSizes[6], fn.argSizes[7]
+		);
+	});
+
+	qcvm_writeSection(out, prefix, "globals", "QC_Value", globals, numGlobals, [](std::string &o, const QC_Value &val){
+		o += fmt::format("{{ .u32 = {:#x}u }}", val.u32);
+	});
+
+	// explicit conversions so bytes above 0x7f are not narrowing, whatever the signedness of char
+	qcvm_writeSection(out, prefix, "strs", "char", strs, strsSize, [](std::string &o, char c){
+		o += fmt::format("char({:#x})", QC_Uint8(c));
+	});
+
+	const auto sectionRef = [&](std::string_view name, QC_Uintptr n){
+		return n ? fmt::format("{}_{}, {}", prefix, name, n) : std::string("nullptr, 0");
+	};
+
+	out += fmt::format("inline constexpr QC_ByteCodeStatic {}_data = {{\n", prefix);
+	out += fmt::format("\t{},\n", sectionRef("stmts", numStmts));
+	out += fmt::format("\t{},\n", sectionRef("defs", numDefs));
+	out += fmt::format("\t{},\n", sectionRef("fields", numFields));
+	out += fmt::format("\t{},\n", sectionRef("fns", numFns));
+	out += fmt::format("\t{},\n", sectionRef("globals", numGlobals));
+	out += fmt::format("\t{},\n", sectionRef("strs", strsSize));
+	out += fmt::format("\t{},\n", numEntityFields);
+	out += "};\n\n";
+
+	out += fmt::format("inline QC_ByteCode *{0}_createByteCode(){{ return qcCreateByteCodeStatic(&{0}_data); }}\n\n", prefix);
+	out += fmt::format("#endif // !{}\n", guard);
+
+	qcDestroyByteCode(bc);
+
+	std::ofstream outFile(argv[2], std::ios::binary | std::ios::trunc);
+	if(!outFile){
+		qcLogError("could not open '%s' for writing", argv[2]);
+		return 1;
+	}
+
+	outFile.write(out.data(), std::streamsize(out.size()));
+	return outFile ? 0 : 1;
+}